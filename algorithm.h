@@ -1,12 +1,55 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
 #include "./base.h"
+#include "./simd.h"
 
 namespace cexpr {
 
+// runtime search over contiguous numbers: the predicate runs on whole
+// blocks without branching, which compilers vectorize for simple
+// predicates, and only a block with a hit is searched element by element.
+// the predicate may therefore see elements past the answer, and the block
+// with the hit twice. with negate set it looks for the first element
+// failing the predicate
+template <typename It>
+constexpr bool isBlockedRange =
+    std::is_pointer<It>::value &&
+    std::is_arithmetic<std::remove_cv_t<std::remove_pointer_t<It>>>::value;
+
+template <bool negate, typename T, typename UnaryPredicate>
+T* findIfBlocked(T* first, T* last, UnaryPredicate& predicate) {
+  constexpr std::ptrdiff_t block = 32;
+  for (; last - first >= block; first += block) {
+    unsigned char hits = 0;
+    for (std::ptrdiff_t i = 0; i < block; i++) {
+      hits |= static_cast<unsigned char>(
+          static_cast<bool>(predicate(first[i])) != negate);
+    }
+    if (hits != 0) {
+      break;
+    }
+  }
+  for (; first != last; ++first) {
+    if (static_cast<bool>(predicate(*first)) != negate) {
+      return first;
+    }
+  }
+  return last;
+}
+
 template <typename ForwardIterator, typename UnaryOp>
 constexpr bool all_of(ForwardIterator begin, ForwardIterator end, UnaryOp op) {
+  if constexpr (isBlockedRange<ForwardIterator>) {
+    if (!is_constant_evaluated()) {
+      return findIfBlocked<true>(begin, end, op) == end;
+    }
+  }
   while (begin != end) {
     if (!op(*begin)) {
       return false;
@@ -18,6 +61,11 @@ constexpr bool all_of(ForwardIterator begin, ForwardIterator end, UnaryOp op) {
 
 template <typename ForwardIterator, typename UnaryOp>
 constexpr bool any_of(ForwardIterator begin, ForwardIterator end, UnaryOp op) {
+  if constexpr (isBlockedRange<ForwardIterator>) {
+    if (!is_constant_evaluated()) {
+      return findIfBlocked<false>(begin, end, op) != end;
+    }
+  }
   while (begin != end) {
     if (op(*begin)) {
       return true;
@@ -71,6 +119,11 @@ void for_each(const std::array<T, size>& cinput, UnaryOp unaryOp) {
 template <typename ForwardIterator, typename T>
 constexpr size_t count(
   ForwardIterator begin, ForwardIterator end, const T& val) {
+  if constexpr (isSimdRange<ForwardIterator, T>) {
+    if (!is_constant_evaluated()) {
+      return countEqual(begin, end, val);
+    }
+  }
   size_t cnt = 0;
   for (; begin != end; begin++) {
     cnt += *begin == val;
@@ -100,6 +153,15 @@ constexpr bool equal(ForwardIterator lBegin,
                      ForwardIterator lEnd, ForwardIterator rBegin,
                      ForwardIterator rEnd) {
   using T = typename std::iterator_traits<ForwardIterator>::value_type;
+  if constexpr (std::is_pointer<ForwardIterator>::value &&
+                std::is_integral<T>::value) {
+    // integers compare bytewise, memcmp is already vectorized
+    if (!is_constant_evaluated()) {
+      size_t len = static_cast<size_t>(lEnd - lBegin);
+      return len == static_cast<size_t>(rEnd - rBegin) &&
+             (len == 0 || std::memcmp(lBegin, rBegin, len * sizeof(T)) == 0);
+    }
+  }
   return equal(lBegin, lEnd, rBegin, rEnd, [](const T& lhs, const T& rhs) {
     return lhs == rhs; 
   });
@@ -111,6 +173,11 @@ constexpr ForwardIterator find_if(
   ForwardIterator begin,
   ForwardIterator end,
   UnaryPredicate predicate) {
+  if constexpr (isBlockedRange<ForwardIterator>) {
+    if (!is_constant_evaluated()) {
+      return findIfBlocked<false>(begin, end, predicate);
+    }
+  }
   for (; begin != end; begin++) {
     if (predicate(*begin)) {
       return begin;
@@ -119,6 +186,22 @@ constexpr ForwardIterator find_if(
   return end;
 }
 
+template <typename ForwardIterator, typename T>
+constexpr ForwardIterator find(ForwardIterator begin, ForwardIterator end,
+                               const T& val) {
+  if constexpr (isSimdRange<ForwardIterator, T>) {
+    if (!is_constant_evaluated()) {
+      return begin + (findEqual(begin, end, val) - begin);
+    }
+  }
+  for (; begin != end; begin++) {
+    if (*begin == val) {
+      return begin;
+    }
+  }
+  return end;
+}
+
 template<typename Predicate, typename T>
 struct UnaryPredicateNegation {
   constexpr UnaryPredicateNegation(Predicate predicate): predicate_(predicate) {}
@@ -162,6 +245,11 @@ constexpr ForwardIt adjacent_find(ForwardIt first, ForwardIt last,
 template<class ForwardIt>
 constexpr ForwardIt adjacent_find(ForwardIt first, ForwardIt last) {
   using T = typename std::iterator_traits<ForwardIt>::value_type;
+  if constexpr (isSimdRange<ForwardIt>) {
+    if (!is_constant_evaluated()) {
+      return first + (adjacentEqual(first, last) - first);
+    }
+  }
   return adjacent_find(first, last, [](const T& lhs, const T& rhs) {
     return lhs == rhs;
   });
@@ -252,6 +340,15 @@ constexpr OutputIt copy(InputIt first, InputIt last,
 // iter_swap
 // 	swaps the elements pointed to by two iterators
 // (function template)
+
+// std::iter_swap is only constexpr from C++20
+template <typename ForwardIt1, typename ForwardIt2>
+constexpr void iter_swap(ForwardIt1 lhs, ForwardIt2 rhs) {
+  auto tmp = std::move(*lhs);
+  *lhs = std::move(*rhs);
+  *rhs = std::move(tmp);
+}
+
 // reverse
 // 	reverses the order of elements in a range
 // (function template)
@@ -348,6 +445,138 @@ constexpr bool is_sorted(ForwardIt first, ForwardIt last) {
 // sort
 // 	sorts a range into ascending order
 // (function template)
+
+template <typename T>
+struct Less {
+  constexpr bool operator()(const T& lhs, const T& rhs) const {
+    return lhs < rhs;
+  }
+};
+
+// below this many elements the sorts fall back to insertion sort
+constexpr std::ptrdiff_t sortRunSize = 16;
+
+template <typename RandomIt, typename Compare>
+constexpr void insertionSort(RandomIt first, RandomIt last, Compare comp) {
+  if (first == last) {
+    return;
+  }
+  for (RandomIt it = first + 1; it != last; ++it) {
+    auto val = std::move(*it);
+    RandomIt hole = it;
+    for (; hole != first && comp(val, *(hole - 1)); --hole) {
+      *hole = std::move(*(hole - 1));
+    }
+    *hole = std::move(val);
+  }
+}
+
+template <typename RandomIt, typename Compare>
+constexpr void siftDown(RandomIt first, std::ptrdiff_t root,
+                        std::ptrdiff_t len, Compare comp) {
+  while (true) {
+    std::ptrdiff_t child = root * 2 + 1;
+    if (child >= len) {
+      return;
+    }
+    if (child + 1 < len && comp(first[child], first[child + 1])) {
+      child++;
+    }
+    if (!comp(first[root], first[child])) {
+      return;
+    }
+    cexpr::iter_swap(first + root, first + child);
+    root = child;
+  }
+}
+
+template <typename RandomIt, typename Compare>
+constexpr void heapSort(RandomIt first, RandomIt last, Compare comp) {
+  std::ptrdiff_t len = last - first;
+  for (std::ptrdiff_t i = len / 2; i > 0; i--) {
+    siftDown(first, i - 1, len, comp);
+  }
+  for (std::ptrdiff_t end = len - 1; end > 0; end--) {
+    cexpr::iter_swap(first, first + end);
+    siftDown(first, 0, end, comp);
+  }
+}
+
+// iterative introsort: quicksort on a median of three, always continuing
+// with the smaller side so the explicit stack stays under 64 entries,
+// heapsort once the depth budget runs out, and one insertion sort pass
+// over the nearly sorted result
+template <typename RandomIt, typename Compare>
+constexpr void sort(RandomIt first, RandomIt last, Compare comp) {
+  struct Range {
+    RandomIt first;
+    RandomIt last;
+    int depth;
+  };
+
+  int depth = 0;
+  for (std::ptrdiff_t len = last - first; len > 1; len >>= 1) {
+    depth += 2;
+  }
+  Range stack[64] = {};
+  size_t top = 0;
+  stack[top++] = {first, last, depth};
+  while (top != 0) {
+    Range range = stack[--top];
+    while (range.last - range.first > sortRunSize) {
+      if (range.depth == 0) {
+        heapSort(range.first, range.last, comp);
+        break;
+      }
+      range.depth--;
+
+      RandomIt lo = range.first;
+      RandomIt mid = lo + (range.last - lo) / 2;
+      RandomIt hi = range.last - 1;
+      if (comp(*mid, *lo)) {
+        cexpr::iter_swap(mid, lo);
+      }
+      if (comp(*hi, *mid)) {
+        cexpr::iter_swap(hi, mid);
+        if (comp(*mid, *lo)) {
+          cexpr::iter_swap(mid, lo);
+        }
+      }
+      auto pivot = *mid;
+
+      // hoare partition, the median of three keeps both scans in range
+      while (true) {
+        while (comp(*lo, pivot)) {
+          ++lo;
+        }
+        while (comp(pivot, *hi)) {
+          --hi;
+        }
+        if (!(lo < hi)) {
+          break;
+        }
+        cexpr::iter_swap(lo, hi);
+        ++lo;
+        --hi;
+      }
+
+      if (lo - range.first < range.last - lo) {
+        stack[top++] = {lo, range.last, range.depth};
+        range.last = lo;
+      } else {
+        stack[top++] = {range.first, lo, range.depth};
+        range.first = lo;
+      }
+    }
+  }
+  insertionSort(first, last, comp);
+}
+
+template <typename RandomIt>
+constexpr void sort(RandomIt first, RandomIt last) {
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  cexpr::sort(first, last, Less<T>());
+}
 // partial_sort
 // 	sorts the first N elements of a range
 // (function template)
@@ -357,6 +586,63 @@ constexpr bool is_sorted(ForwardIt first, ForwardIt last) {
 // stable_sort
 // 	sorts a range of elements while preserving order between equal elements
 // (function template)
+
+// merges every pair of neighbouring sorted runs of width elements from in
+// into out, taking from the left run on ties
+template <typename InIt, typename OutIt, typename Compare>
+constexpr void mergeRuns(InIt in, OutIt out, std::ptrdiff_t len,
+                         std::ptrdiff_t width, Compare comp) {
+  for (std::ptrdiff_t lo = 0; lo < len; lo += width * 2) {
+    std::ptrdiff_t mid = lo + width < len ? lo + width : len;
+    std::ptrdiff_t hi = mid + width < len ? mid + width : len;
+    std::ptrdiff_t left = lo;
+    std::ptrdiff_t right = mid;
+    std::ptrdiff_t dst = lo;
+    while (left != mid && right != hi) {
+      if (comp(in[right], in[left])) {
+        out[dst++] = std::move(in[right++]);
+      } else {
+        out[dst++] = std::move(in[left++]);
+      }
+    }
+    while (left != mid) {
+      out[dst++] = std::move(in[left++]);
+    }
+    while (right != hi) {
+      out[dst++] = std::move(in[right++]);
+    }
+  }
+}
+
+// bottom up merge sort: insertion sort on short runs, then merge passes
+// going back and forth between the range and scratch, which must have
+// room for last - first elements
+template <typename RandomIt, typename ScratchIt, typename Compare>
+constexpr void stable_sort(RandomIt first, RandomIt last, ScratchIt scratch,
+                           Compare comp) {
+  std::ptrdiff_t len = last - first;
+  for (std::ptrdiff_t lo = 0; lo < len; lo += sortRunSize) {
+    insertionSort(first + lo,
+                  lo + sortRunSize < len ? first + lo + sortRunSize : last,
+                  comp);
+  }
+  for (std::ptrdiff_t width = sortRunSize; width < len; width *= 4) {
+    mergeRuns(first, scratch, len, width, comp);
+    if (width * 2 >= len) {
+      for (std::ptrdiff_t i = 0; i < len; i++) {
+        first[i] = std::move(scratch[i]);
+      }
+      return;
+    }
+    mergeRuns(scratch, first, len, width * 2, comp);
+  }
+}
+
+template <typename RandomIt, typename ScratchIt>
+constexpr void stable_sort(RandomIt first, RandomIt last, ScratchIt scratch) {
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  cexpr::stable_sort(first, last, scratch, Less<T>());
+}
 // nth_element
 // 	partially sorts the given range making sure that it is partitioned by
 // the given element
@@ -366,15 +652,94 @@ constexpr bool is_sorted(ForwardIt first, ForwardIt last) {
 // lower_bound
 // 	returns an iterator to the first element not less than the given value
 // (function template)
+
+template <typename ForwardIt, typename T, typename Compare>
+constexpr ForwardIt lower_bound(ForwardIt first, ForwardIt last, const T& val,
+                                Compare comp) {
+  auto len = std::distance(first, last);
+  while (len > 0) {
+    auto half = len / 2;
+    ForwardIt mid = first;
+    std::advance(mid, half);
+    if (comp(*mid, val)) {
+      first = ++mid;
+      len -= half + 1;
+    } else {
+      len = half;
+    }
+  }
+  return first;
+}
+
+template <typename ForwardIt, typename T>
+constexpr ForwardIt lower_bound(ForwardIt first, ForwardIt last,
+                                const T& val) {
+  return cexpr::lower_bound(first, last, val, Less<T>());
+}
+
 // upper_bound
 // 	returns an iterator to the first element greater than a certain value
 // (function template)
+
+template <typename ForwardIt, typename T, typename Compare>
+constexpr ForwardIt upper_bound(ForwardIt first, ForwardIt last, const T& val,
+                                Compare comp) {
+  auto len = std::distance(first, last);
+  while (len > 0) {
+    auto half = len / 2;
+    ForwardIt mid = first;
+    std::advance(mid, half);
+    if (!comp(val, *mid)) {
+      first = ++mid;
+      len -= half + 1;
+    } else {
+      len = half;
+    }
+  }
+  return first;
+}
+
+template <typename ForwardIt, typename T>
+constexpr ForwardIt upper_bound(ForwardIt first, ForwardIt last,
+                                const T& val) {
+  return cexpr::upper_bound(first, last, val, Less<T>());
+}
+
 // binary_search
 // 	determines if an element exists in a certain range
 // (function template)
+
+template <typename ForwardIt, typename T, typename Compare>
+constexpr bool binary_search(ForwardIt first, ForwardIt last, const T& val,
+                             Compare comp) {
+  first = cexpr::lower_bound(first, last, val, comp);
+  return first != last && !comp(val, *first);
+}
+
+template <typename ForwardIt, typename T>
+constexpr bool binary_search(ForwardIt first, ForwardIt last, const T& val) {
+  return cexpr::binary_search(first, last, val, Less<T>());
+}
+
 // equal_range
 // 	returns range of elements matching a specific key
 // (function template)
+
+template <typename ForwardIt, typename T, typename Compare>
+constexpr std::pair<ForwardIt, ForwardIt> equal_range(ForwardIt first,
+                                                      ForwardIt last,
+                                                      const T& val,
+                                                      Compare comp) {
+  return {cexpr::lower_bound(first, last, val, comp),
+          cexpr::upper_bound(first, last, val, comp)};
+}
+
+template <typename ForwardIt, typename T>
+constexpr std::pair<ForwardIt, ForwardIt> equal_range(ForwardIt first,
+                                                      ForwardIt last,
+                                                      const T& val) {
+  return cexpr::equal_range(first, last, val, Less<T>());
+}
 // Set operations (on sorted ranges)
 // Defined in header <algorithm>
 // merge
@@ -470,6 +835,83 @@ constexpr bool is_sorted(ForwardIt first, ForwardIt last) {
 // accumulate
 // 	sums up a range of elements
 // (function template)
+
+template <typename T>
+struct Plus {
+  constexpr T operator()(const T& lhs, const T& rhs) const {
+    return lhs + rhs;
+  }
+};
+
+template <typename T>
+struct Multiplies {
+  constexpr T operator()(const T& lhs, const T& rhs) const {
+    return lhs * rhs;
+  }
+};
+
+// runtime reduction of load(0) .. load(len - 1) into independent
+// accumulators, one per lane, which compilers keep in vector registers.
+// the lanes are combined as a tree at the end, so this is only right for
+// operations where grouping and order do not matter
+template <typename T, typename BinaryOp, typename Load>
+T reduceLanes(size_t len, T init, BinaryOp op, Load load) {
+  constexpr size_t lanes = 16;
+  if (len < lanes) {
+    for (size_t i = 0; i < len; i++) {
+      init = op(init, load(i));
+    }
+    return init;
+  }
+  T acc[lanes];
+  for (size_t j = 0; j < lanes; j++) {
+    acc[j] = load(j);
+  }
+  // whole blocks, then a tail shorter than one. counted from len alone,
+  // gcc cannot bound a tail that starts where the block loop stopped and
+  // warns about the loop running past the end
+  size_t end = len - len % lanes;
+  for (size_t i = lanes; i != end; i += lanes) {
+    for (size_t j = 0; j < lanes; j++) {
+      acc[j] = op(acc[j], load(i + j));
+    }
+  }
+  for (size_t j = 0; j < len % lanes; j++) {
+    acc[0] = op(acc[0], load(end + j));
+  }
+  for (size_t width = lanes / 2; width != 0; width /= 2) {
+    for (size_t j = 0; j < width; j++) {
+      acc[j] = op(acc[j], acc[j + width]);
+    }
+  }
+  return op(init, acc[0]);
+}
+
+// strictly left to right, op may depend on the order
+template <typename InputIt, typename T, typename BinaryOp>
+constexpr T accumulate(InputIt first, InputIt last, T init, BinaryOp op) {
+  for (; first != last; ++first) {
+    init = op(init, *first);
+  }
+  return init;
+}
+
+// left to right as well, except that summing integers at runtime takes
+// the lanes above since the order does not show in the result
+template <typename InputIt, typename T>
+constexpr T accumulate(InputIt first, InputIt last, T init) {
+  using Elem = typename std::iterator_traits<InputIt>::value_type;
+  if constexpr (std::is_pointer<InputIt>::value &&
+                std::is_integral<T>::value && std::is_integral<Elem>::value) {
+    if (!is_constant_evaluated()) {
+      return reduceLanes(static_cast<size_t>(last - first), init, Plus<T>(),
+                         [first](size_t i) {
+                           return static_cast<T>(first[i]);
+                         });
+    }
+  }
+  return cexpr::accumulate(first, last, init, Plus<T>());
+}
 // inner_product
 // 	computes the inner product of two ranges of elements
 // (function template)
@@ -483,20 +925,182 @@ constexpr bool is_sorted(ForwardIt first, ForwardIt last) {
 // (C++17)
 // 	similar to std::accumulate, except out of order
 // (function template)
+
+// op has to be associative and commutative, arithmetic types are reduced
+// in lanes at runtime
+template <typename InputIt, typename T, typename BinaryOp>
+constexpr T reduce(InputIt first, InputIt last, T init, BinaryOp op) {
+  if constexpr (std::is_pointer<InputIt>::value &&
+                std::is_arithmetic<T>::value) {
+    if (!is_constant_evaluated()) {
+      return reduceLanes(static_cast<size_t>(last - first), init, op,
+                         [first](size_t i) {
+                           return static_cast<T>(first[i]);
+                         });
+    }
+  }
+  return cexpr::accumulate(first, last, init, op);
+}
+
+template <typename InputIt, typename T>
+constexpr T reduce(InputIt first, InputIt last, T init) {
+  return cexpr::reduce(first, last, init, Plus<T>());
+}
+
+template <typename InputIt>
+constexpr typename std::iterator_traits<InputIt>::value_type reduce(
+    InputIt first, InputIt last) {
+  using T = typename std::iterator_traits<InputIt>::value_type;
+  return cexpr::reduce(first, last, T{}, Plus<T>());
+}
+
+template <typename T, size_t size, typename U = T, typename BinaryOp = Plus<U>>
+constexpr U reduce_array(const std::array<T, size>& input, U init = U{},
+                         BinaryOp op = BinaryOp()) {
+  return cexpr::reduce(input.begin(), input.end(), init, op);
+}
 // exclusive_scan
 // (C++17)
 // 	similar to std::partial_sum, excludes the ith input element from the ith
 // sum
 // (function template)
+
+// out may be the range being scanned
+template <typename InputIt, typename OutputIt, typename T, typename BinaryOp>
+constexpr OutputIt exclusive_scan(InputIt first, InputIt last, OutputIt out,
+                                  T init, BinaryOp op) {
+  for (; first != last; ++first, ++out) {
+    T val = *first;
+    *out = init;
+    init = op(init, val);
+  }
+  return out;
+}
+
+template <typename InputIt, typename OutputIt, typename T>
+constexpr OutputIt exclusive_scan(InputIt first, InputIt last, OutputIt out,
+                                  T init) {
+  if constexpr (std::is_pointer<InputIt>::value &&
+                std::is_pointer<OutputIt>::value &&
+                std::is_same<std::remove_cv_t<std::remove_pointer_t<InputIt>>,
+                             T>::value &&
+                std::is_same<std::remove_pointer_t<OutputIt>, T>::value &&
+                hasSimdScan<T>()) {
+    if (!is_constant_evaluated()) {
+      return exclusiveScanSum(first, last, out, init);
+    }
+  }
+  return cexpr::exclusive_scan(first, last, out, init, Plus<T>());
+}
+
+// offset tables: the ith entry is init plus the sizes before it
+template <typename T, size_t size, typename U>
+constexpr std::array<U, size> exclusive_scan_array(
+    const std::array<T, size>& input, U init) {
+  std::array<U, size> output{};
+  cexpr::exclusive_scan(input.begin(), input.end(), output.begin(), init);
+  return output;
+}
 // inclusive_scan
 // (C++17)
 // 	similar to std::partial_sum, includes the ith input element in the ith
 // sum
 // (function template)
+
+template <typename InputIt, typename OutputIt, typename BinaryOp, typename T>
+constexpr OutputIt inclusive_scan(InputIt first, InputIt last, OutputIt out,
+                                  BinaryOp op, T init) {
+  for (; first != last; ++first, ++out) {
+    init = op(init, *first);
+    *out = init;
+  }
+  return out;
+}
+
+template <typename InputIt, typename OutputIt, typename BinaryOp>
+constexpr OutputIt inclusive_scan(InputIt first, InputIt last, OutputIt out,
+                                  BinaryOp op) {
+  if (first == last) {
+    return out;
+  }
+  typename std::iterator_traits<InputIt>::value_type init = *first;
+  *out = init;
+  return cexpr::inclusive_scan(++first, last, ++out, op, init);
+}
+
+template <typename InputIt, typename OutputIt>
+constexpr OutputIt inclusive_scan(InputIt first, InputIt last, OutputIt out) {
+  using T = typename std::iterator_traits<InputIt>::value_type;
+  if constexpr (std::is_pointer<InputIt>::value &&
+                std::is_pointer<OutputIt>::value &&
+                std::is_same<std::remove_pointer_t<OutputIt>, T>::value &&
+                hasSimdScan<T>()) {
+    if (!is_constant_evaluated()) {
+      return inclusiveScanSum(first, last, out, T{});
+    }
+  }
+  return cexpr::inclusive_scan(first, last, out, Plus<T>());
+}
+
+template <typename T, size_t size>
+constexpr std::array<T, size> inclusive_scan_array(
+    const std::array<T, size>& input) {
+  std::array<T, size> output{};
+  cexpr::inclusive_scan(input.begin(), input.end(), output.begin());
+  return output;
+}
 // transform_reduce
 // (C++17)
 // 	applies a functor, then reduces out of order
 // (function template)
+
+template <typename InputIt, typename T, typename BinaryOp, typename UnaryOp>
+constexpr T transform_reduce(InputIt first, InputIt last, T init,
+                             BinaryOp reduceOp, UnaryOp transformOp) {
+  if constexpr (std::is_pointer<InputIt>::value &&
+                std::is_arithmetic<T>::value) {
+    if (!is_constant_evaluated()) {
+      return reduceLanes(static_cast<size_t>(last - first), init, reduceOp,
+                         [first, &transformOp](size_t i) {
+                           return static_cast<T>(transformOp(first[i]));
+                         });
+    }
+  }
+  for (; first != last; ++first) {
+    init = reduceOp(init, transformOp(*first));
+  }
+  return init;
+}
+
+template <typename InputIt1, typename InputIt2, typename T,
+          typename BinaryOp1, typename BinaryOp2>
+constexpr T transform_reduce(InputIt1 first1, InputIt1 last1,
+                             InputIt2 first2, T init, BinaryOp1 reduceOp,
+                             BinaryOp2 transformOp) {
+  if constexpr (std::is_pointer<InputIt1>::value &&
+                std::is_pointer<InputIt2>::value &&
+                std::is_arithmetic<T>::value) {
+    if (!is_constant_evaluated()) {
+      return reduceLanes(static_cast<size_t>(last1 - first1), init, reduceOp,
+                         [first1, first2, &transformOp](size_t i) {
+                           return static_cast<T>(
+                               transformOp(first1[i], first2[i]));
+                         });
+    }
+  }
+  for (; first1 != last1; ++first1, ++first2) {
+    init = reduceOp(init, transformOp(*first1, *first2));
+  }
+  return init;
+}
+
+// inner product
+template <typename InputIt1, typename InputIt2, typename T>
+constexpr T transform_reduce(InputIt1 first1, InputIt1 last1,
+                             InputIt2 first2, T init) {
+  return cexpr::transform_reduce(first1, last1, first2, init, Plus<T>(),
+                                 Multiplies<T>());
+}
 // transform_exclusive_scan
 // (C++17)
 // 	applies a functor, then calculates exclusive scan
@@ -1,9 +1,39 @@
 #pragma once
 
 #include <array>
+#include <type_traits>
+
+// lets optional members of the containers take no space when unused
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(no_unique_address)
+#define CEXPR_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+#endif
+#ifndef CEXPR_NO_UNIQUE_ADDRESS
+#define CEXPR_NO_UNIQUE_ADDRESS
+#endif
 
 namespace cexpr {
 
+// std::is_constant_evaluated is C++20, gcc and clang expose the builtin
+// in C++17 as well
+constexpr bool is_constant_evaluated() noexcept {
+#if defined(__cpp_lib_is_constant_evaluated)
+  return std::is_constant_evaluated();
+#else
+  return __builtin_is_constant_evaluated();
+#endif
+}
+
+// cache hint only, does nothing during constant evaluation
+constexpr void prefetch(const void* addr) {
+  if (!is_constant_evaluated()) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(addr);
+#endif
+  }
+}
+
 template<typename Arr>
 constexpr typename Arr::value_type& getRef(
   const Arr& buf,
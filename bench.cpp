@@ -0,0 +1,1066 @@
+// runtime benchmarks, standard library and pthreads only:
+//   g++ -std=c++17 -O2 -march=native -pthread bench.cpp -o bench
+//   ./bench [group...]
+// runs every group when none is named
+#include <pthread.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "./const_hashmap.h"
+#include "./enum_map.h"
+#include "./execution.h"
+#include "./flat_map.h"
+#include "./mapped_hashmap.h"
+#include "./switch_map.h"
+#include "./table_handle.h"
+
+namespace {
+
+struct StrComparator {
+  int operator()(const char* lhs, const char* rhs) const {
+    return rhs == nullptr ? 1 : std::strcmp(lhs, rhs);
+  }
+};
+
+std::vector<std::string> makeKeys(size_t count, size_t len, uint32_t seed) {
+  static const char alphabet[] =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_/";
+  std::mt19937 rng(seed);
+  std::vector<std::string> keys;
+  keys.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    // the index keeps every key distinct
+    std::string key = "/" + std::to_string(i) + "/";
+    while (key.size() < len) {
+      key += alphabet[rng() % (sizeof(alphabet) - 1)];
+    }
+    keys.push_back(std::move(key));
+  }
+  return keys;
+}
+
+// picks count queries among keys, in random order. a hitPercent share of
+// them come from keys, the rest from misses
+std::vector<const char*> makeQueries(const std::vector<std::string>& keys,
+                                     size_t count, uint32_t seed,
+                                     const std::vector<std::string>& misses =
+                                         {},
+                                     unsigned hitPercent = 100) {
+  std::mt19937 rng(seed);
+  std::vector<const char*> queries(count);
+  for (auto& query : queries) {
+    if (rng() % 100 < hitPercent) {
+      query = keys[rng() % keys.size()].c_str();
+    } else {
+      query = misses[rng() % misses.size()].c_str();
+    }
+  }
+  return queries;
+}
+
+uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+struct Timing {
+  double ns;
+  // time stamp counter ticks, 0 where there is none
+  double cycles;
+};
+
+// runs fn, which performs ops lookups, until enough time has passed
+template <typename Fn>
+Timing measure(size_t ops, Fn fn) {
+  using Clock = std::chrono::steady_clock;
+  fn();
+  size_t rounds = 0;
+  uint64_t startCycles = cycles();
+  auto start = Clock::now();
+  auto elapsed = Clock::duration::zero();
+  do {
+    fn();
+    rounds++;
+    elapsed = Clock::now() - start;
+  } while (elapsed < std::chrono::milliseconds(200));
+  double total = static_cast<double>(rounds) * ops;
+  return {std::chrono::duration<double, std::nano>(elapsed).count() / total,
+          (cycles() - startCycles) / total};
+}
+
+template <typename Fn>
+double nsPerOp(size_t ops, Fn fn) {
+  return measure(ops, fn).ns;
+}
+
+volatile uintptr_t sink;
+
+void report(const char* name, size_t keys, double ns) {
+  std::printf("%-28s %8zu keys %8.2f ns/lookup\n", name, keys, ns);
+}
+
+// HashMap builds its scratch arrays on the stack, large tables need a
+// bigger one than the main thread has when they are built at runtime
+void runWithStack(size_t bytes, std::function<void()> fn) {
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, bytes);
+  pthread_t thread;
+  pthread_create(
+      &thread, &attr,
+      [](void* arg) -> void* {
+        (*static_cast<std::function<void()>*>(arg))();
+        return nullptr;
+      },
+      &fn);
+  pthread_join(thread, nullptr);
+  pthread_attr_destroy(&attr);
+}
+
+template <size_t size>
+using Pairs = std::array<std::pair<const char*, uint32_t>, size>;
+
+template <size_t size, typename Hash>
+using BenchMap =
+    cexpr::HashMap<size, cexpr::getPerfectHashSize<Hash>(Pairs<size>{}),
+                   const char*, uint32_t, StrComparator, Hash>;
+
+template <size_t size, typename Hash>
+std::unique_ptr<BenchMap<size, Hash>> buildMap(
+    const std::vector<std::string>& keys) {
+  auto pairs = std::make_unique<Pairs<size>>();
+  for (size_t i = 0; i < size; i++) {
+    (*pairs)[i] = {keys[i].c_str(), static_cast<uint32_t>(i + 1)};
+  }
+  return std::make_unique<BenchMap<size, Hash>>(*pairs);
+}
+
+// scalar get against get_many, on a table that fits in cache and on one
+// well past L2
+template <size_t size>
+void benchGetMany() {
+  auto keys = makeKeys(size, 32, size);
+  auto map = buildMap<size, cexpr::wordHasher>(keys);
+  auto queries = makeQueries(keys, 1 << 20, 1);
+
+  report("get", size, nsPerOp(queries.size(), [&] {
+           uintptr_t sum = 0;
+           for (const char* query : queries) {
+             sum += map->get(query);
+           }
+           sink = sum;
+         }));
+
+  for (size_t batch : {16, 32, 64}) {
+    std::vector<uint32_t> values(batch);
+    std::string name = "get_many/" + std::to_string(batch);
+    report(name.c_str(), size, nsPerOp(queries.size(), [&] {
+             uintptr_t sum = 0;
+             for (size_t i = 0; i + batch <= queries.size(); i += batch) {
+               map->get_many(&queries[i], values.data(), batch);
+               sum += values[0];
+             }
+             sink = sum;
+           }));
+  }
+}
+
+
+void reportLookup(const char* engine, size_t keys, size_t keyLen,
+                  unsigned hitPercent, Timing timing) {
+  std::printf("%-22s %7zu keys %3zuB keys %3u%% hits %8.2f ns %8.1f cycles\n",
+              engine, keys, keyLen, hitPercent, timing.ns, timing.cycles);
+}
+
+template <size_t size, typename Hash>
+void benchHashMap(const char* name, const std::vector<std::string>& keys,
+                  const std::vector<const char*>& queries, size_t keyLen,
+                  unsigned hitPercent) {
+  auto map = buildMap<size, Hash>(keys);
+  reportLookup(name, size, keyLen, hitPercent,
+               measure(queries.size(), [&] {
+                 uintptr_t sum = 0;
+                 for (const char* query : queries) {
+                   sum += map->get(query);
+                 }
+                 sink = sum;
+               }));
+}
+
+// HashMap with both fnv hashers against the standard containers, a
+// sorted array and a linear scan, which is what an if/strcmp chain does
+template <size_t size>
+void benchLookups() {
+  for (size_t keyLen : {16, 64}) {
+    auto keys = makeKeys(size, keyLen, size);
+    // the index prefix keeps misses apart from the keys
+    auto misses = makeKeys(size * 2, keyLen, size + 1);
+    misses.erase(misses.begin(), misses.begin() + size);
+
+    std::unordered_map<std::string_view, uint32_t> unordered;
+    std::map<std::string_view, uint32_t> ordered;
+    std::vector<std::pair<std::string_view, uint32_t>> sorted;
+    for (size_t i = 0; i < size; i++) {
+      unordered.emplace(keys[i], i + 1);
+      ordered.emplace(keys[i], i + 1);
+      sorted.emplace_back(keys[i], i + 1);
+    }
+    std::sort(sorted.begin(), sorted.end());
+
+    for (unsigned hitPercent : {100, 50, 0}) {
+      auto queries = makeQueries(keys, 1 << 16, 1, misses, hitPercent);
+      benchHashMap<size, cexpr::fnv1Hasher>("HashMap/fnv1", keys, queries,
+                                            keyLen, hitPercent);
+      benchHashMap<size, cexpr::fnv1aHasher>("HashMap/fnv1a", keys, queries,
+                                             keyLen, hitPercent);
+
+      reportLookup("std::unordered_map", size, keyLen, hitPercent,
+                   measure(queries.size(), [&] {
+                     uintptr_t sum = 0;
+                     for (const char* query : queries) {
+                       auto it = unordered.find(query);
+                       sum += it == unordered.end() ? 0 : it->second;
+                     }
+                     sink = sum;
+                   }));
+      reportLookup("std::map", size, keyLen, hitPercent,
+                   measure(queries.size(), [&] {
+                     uintptr_t sum = 0;
+                     for (const char* query : queries) {
+                       auto it = ordered.find(query);
+                       sum += it == ordered.end() ? 0 : it->second;
+                     }
+                     sink = sum;
+                   }));
+      reportLookup("sorted array", size, keyLen, hitPercent,
+                   measure(queries.size(), [&] {
+                     uintptr_t sum = 0;
+                     for (const char* query : queries) {
+                       std::string_view key = query;
+                       auto it = std::lower_bound(
+                           sorted.begin(), sorted.end(), key,
+                           [](const auto& lhs, std::string_view rhs) {
+                             return lhs.first < rhs;
+                           });
+                       sum += it != sorted.end() && it->first == key
+                                  ? it->second
+                                  : 0;
+                     }
+                     sink = sum;
+                   }));
+      // quadratic in the table size, only worth it for small tables
+      if (size <= 1000) {
+        reportLookup("linear scan", size, keyLen, hitPercent,
+                     measure(queries.size(), [&] {
+                       uintptr_t sum = 0;
+                       for (const char* query : queries) {
+                         for (const auto& key : keys) {
+                           if (std::strcmp(key.c_str(), query) == 0) {
+                             sum++;
+                             break;
+                           }
+                         }
+                       }
+                       sink = sum;
+                     }));
+      }
+    }
+  }
+}
+
+constexpr Pairs<10> routeKeys{{{"/login", 1},
+                               {"/profile", 2},
+                               {"/feed", 3},
+                               {"/notification", 4},
+                               {"/settings", 5},
+                               {"/videos", 6},
+                               {"/notes", 7},
+                               {"/logout", 8},
+                               {"/messenger", 9},
+                               {"/stories", 10}}};
+
+constexpr Pairs<32> headerKeys{{{"accept", 1},
+                                {"accept-charset", 2},
+                                {"accept-encoding", 3},
+                                {"accept-language", 4},
+                                {"accept-ranges", 5},
+                                {"age", 6},
+                                {"allow", 7},
+                                {"authorization", 8},
+                                {"cache-control", 9},
+                                {"connection", 10},
+                                {"content-encoding", 11},
+                                {"content-language", 12},
+                                {"content-length", 13},
+                                {"content-location", 14},
+                                {"content-range", 15},
+                                {"content-type", 16},
+                                {"cookie", 17},
+                                {"date", 18},
+                                {"etag", 19},
+                                {"expect", 20},
+                                {"expires", 21},
+                                {"from", 22},
+                                {"host", 23},
+                                {"if-match", 24},
+                                {"if-modified-since", 25},
+                                {"if-none-match", 26},
+                                {"last-modified", 27},
+                                {"location", 28},
+                                {"range", 29},
+                                {"referer", 30},
+                                {"server", 31},
+                                {"user-agent", 32}}};
+
+// SwitchMap against HashMap with fnv1, on key sets small enough for a
+// switch. misses share lengths and prefixes with the keys, which is what
+// a switch has to reject with the compare
+template <size_t size, size_t maxLength>
+void benchSwitchMap(const char* set, const Pairs<size>& pairs,
+                    const std::vector<std::string>& misses) {
+  cexpr::SwitchMap<size, maxLength, uint32_t> switchMap(pairs);
+  BenchMap<size, cexpr::fnv1Hasher> hashMap(pairs);
+  std::vector<std::string> keys;
+  for (const auto& pair : pairs) {
+    keys.push_back(pair.first);
+  }
+  std::printf("%s\n", set);
+  for (unsigned hitPercent : {100, 50, 0}) {
+    auto queries = makeQueries(keys, 1 << 16, 1, misses, hitPercent);
+    reportLookup("SwitchMap", size, maxLength, hitPercent,
+                 measure(queries.size(), [&] {
+                   uintptr_t sum = 0;
+                   for (const char* query : queries) {
+                     sum += switchMap.get(query);
+                   }
+                   sink = sum;
+                 }));
+    reportLookup("HashMap/fnv1", size, maxLength, hitPercent,
+                 measure(queries.size(), [&] {
+                   uintptr_t sum = 0;
+                   for (const char* query : queries) {
+                     sum += hashMap.get(query);
+                   }
+                   sink = sum;
+                 }));
+  }
+}
+
+void benchSwitch() {
+  benchSwitchMap<10, cexpr::getMaxKeyLength(routeKeys)>(
+      "routes", routeKeys,
+      {"/logins", "/profiles", "/fees", "/notifications", "/setting",
+       "/video", "/note", "/logoff", "/messages", "/story"});
+  benchSwitchMap<32, cexpr::getMaxKeyLength(headerKeys)>(
+      "headers", headerKeys,
+      {"accept-patch", "content-md5", "cookie2", "dnt", "forwarded",
+       "keep-alive", "origin", "pragma", "upgrade", "via", "warning",
+       "x-request-id", "te", "trailer", "if-range", "max-forwards"});
+}
+
+enum class MessageType : uint8_t {
+  kHello,
+  kHelloAck,
+  kPing,
+  kPong,
+  kSubscribe,
+  kSubscribeAck,
+  kUnsubscribe,
+  kUnsubscribeAck,
+  kPublish,
+  kPublishAck,
+  kFetch,
+  kFetchReply,
+  kCommit,
+  kCommitAck,
+  kHeartbeat,
+  kGoodbye
+};
+
+constexpr std::array<std::pair<MessageType, const char*>, 16> messageTypes{{
+    {MessageType::kHello, "Hello"},
+    {MessageType::kHelloAck, "HelloAck"},
+    {MessageType::kPing, "Ping"},
+    {MessageType::kPong, "Pong"},
+    {MessageType::kSubscribe, "Subscribe"},
+    {MessageType::kSubscribeAck, "SubscribeAck"},
+    {MessageType::kUnsubscribe, "Unsubscribe"},
+    {MessageType::kUnsubscribeAck, "UnsubscribeAck"},
+    {MessageType::kPublish, "Publish"},
+    {MessageType::kPublishAck, "PublishAck"},
+    {MessageType::kFetch, "Fetch"},
+    {MessageType::kFetchReply, "FetchReply"},
+    {MessageType::kCommit, "Commit"},
+    {MessageType::kCommitAck, "CommitAck"},
+    {MessageType::kHeartbeat, "Heartbeat"},
+    {MessageType::kGoodbye, "Goodbye"}}};
+
+// EnumMap against what is usually written by hand: a switch for the name
+// and an if chain or std::unordered_map for parsing
+void benchEnum() {
+  constexpr cexpr::EnumMap<MessageType, messageTypes.size()> enumMap(
+      messageTypes);
+  std::unordered_map<std::string_view, MessageType> unordered;
+  std::vector<std::string> names;
+  for (const auto& entry : messageTypes) {
+    unordered.emplace(entry.second, entry.first);
+    names.push_back(entry.second);
+  }
+  auto switchName = [](MessageType type) -> std::string_view {
+    switch (type) {
+      case MessageType::kHello:
+        return "Hello";
+      case MessageType::kHelloAck:
+        return "HelloAck";
+      case MessageType::kPing:
+        return "Ping";
+      case MessageType::kPong:
+        return "Pong";
+      case MessageType::kSubscribe:
+        return "Subscribe";
+      case MessageType::kSubscribeAck:
+        return "SubscribeAck";
+      case MessageType::kUnsubscribe:
+        return "Unsubscribe";
+      case MessageType::kUnsubscribeAck:
+        return "UnsubscribeAck";
+      case MessageType::kPublish:
+        return "Publish";
+      case MessageType::kPublishAck:
+        return "PublishAck";
+      case MessageType::kFetch:
+        return "Fetch";
+      case MessageType::kFetchReply:
+        return "FetchReply";
+      case MessageType::kCommit:
+        return "Commit";
+      case MessageType::kCommitAck:
+        return "CommitAck";
+      case MessageType::kHeartbeat:
+        return "Heartbeat";
+      case MessageType::kGoodbye:
+        return "Goodbye";
+    }
+    return {};
+  };
+
+  std::mt19937 rng(1);
+  std::vector<MessageType> types(1 << 16);
+  for (auto& type : types) {
+    type = static_cast<MessageType>(rng() % messageTypes.size());
+  }
+  report("EnumMap::name", messageTypes.size(), nsPerOp(types.size(), [&] {
+           uintptr_t sum = 0;
+           for (MessageType type : types) {
+             sum += enumMap.name(type).size();
+           }
+           sink = sum;
+         }));
+  report("switch", messageTypes.size(), nsPerOp(types.size(), [&] {
+           uintptr_t sum = 0;
+           for (MessageType type : types) {
+             sum += switchName(type).size();
+           }
+           sink = sum;
+         }));
+
+  auto queries = makeQueries(names, 1 << 16, 1);
+  report("EnumMap::parse", messageTypes.size(), nsPerOp(queries.size(), [&] {
+           uintptr_t sum = 0;
+           for (const char* query : queries) {
+             sum += static_cast<uintptr_t>(
+                 enumMap.parse(query, MessageType::kHello));
+           }
+           sink = sum;
+         }));
+  report("std::unordered_map", messageTypes.size(),
+         nsPerOp(queries.size(), [&] {
+           uintptr_t sum = 0;
+           for (const char* query : queries) {
+             auto it = unordered.find(query);
+             sum += it == unordered.end() ? 0
+                                          : static_cast<uintptr_t>(it->second);
+           }
+           sink = sum;
+         }));
+  report("if chain", messageTypes.size(), nsPerOp(queries.size(), [&] {
+           uintptr_t sum = 0;
+           for (const char* query : queries) {
+             for (const auto& entry : messageTypes) {
+               if (std::strcmp(entry.second, query) == 0) {
+                 sum += static_cast<uintptr_t>(entry.first);
+                 break;
+               }
+             }
+           }
+           sink = sum;
+         }));
+}
+
+// a value a cache line wide, against the 4 bytes of uint32_t
+struct WideValue {
+  uint32_t id;
+  uint32_t payload[15];
+};
+
+template <size_t size, typename Value, typename Layout>
+using LayoutMap = cexpr::HashMap<
+    size,
+    cexpr::getPerfectHashSize<cexpr::wordHasher>(
+        std::array<std::pair<const char*, Value>, size>{}),
+    const char*, Value, StrComparator, cexpr::wordHasher, false,
+    cexpr::NoInstrumentation, Layout>;
+
+uint32_t valueId(uint32_t value) { return value; }
+uint32_t valueId(const WideValue& value) { return value.id; }
+
+template <typename Value>
+Value makeValue(uint32_t id) {
+  return id;
+}
+
+template <>
+WideValue makeValue<WideValue>(uint32_t id) {
+  return WideValue{id, {}};
+}
+
+template <size_t size, typename Value, typename Layout>
+void benchLayout(const char* name, const std::vector<std::string>& keys,
+                 const std::vector<const char*>& queries,
+                 unsigned hitPercent) {
+  auto pairs =
+      std::make_unique<std::array<std::pair<const char*, Value>, size>>();
+  for (size_t i = 0; i < size; i++) {
+    (*pairs)[i].first = keys[i].c_str();
+    (*pairs)[i].second = makeValue<Value>(static_cast<uint32_t>(i + 1));
+  }
+  auto map = std::make_unique<LayoutMap<size, Value, Layout>>(*pairs);
+  std::string engine = std::string(name) + "/" +
+                       (sizeof(Value) == 4 ? "4B" : "64B");
+  reportLookup(engine.c_str(), size, 32, hitPercent,
+               measure(queries.size(), [&] {
+                 uintptr_t sum = 0;
+                 for (const char* query : queries) {
+                   sum += valueId(map->get(query));
+                 }
+                 sink = sum;
+               }));
+}
+
+// both slot layouts, with small and cache line values. every lookup
+// compares one key, so what differs is how many keys share a cache line
+// and whether a hit pulls in a second one for its value
+template <size_t size>
+void benchLayouts() {
+  auto keys = makeKeys(size, 32, size);
+  auto misses = makeKeys(size * 2, 32, size + 1);
+  misses.erase(misses.begin(), misses.begin() + size);
+  for (unsigned hitPercent : {100, 50, 0}) {
+    auto queries = makeQueries(keys, 1 << 18, 1, misses, hitPercent);
+    benchLayout<size, uint32_t, cexpr::AosLayout>("aos", keys, queries,
+                                                  hitPercent);
+    benchLayout<size, uint32_t, cexpr::SoaLayout>("soa", keys, queries,
+                                                  hitPercent);
+    benchLayout<size, WideValue, cexpr::AosLayout>("aos", keys, queries,
+                                                   hitPercent);
+    benchLayout<size, WideValue, cexpr::SoaLayout>("soa", keys, queries,
+                                                   hitPercent);
+  }
+}
+
+// what a process pays at startup for a table known only at deploy time:
+// filling a std::unordered_map against mapping a serialized table, then
+// the lookups on both. the blob is built once, as a deploy step would
+template <size_t size>
+void benchMapped() {
+  auto keys = makeKeys(size, 24, size);
+  std::vector<std::pair<std::string, uint32_t>> entries;
+  for (size_t i = 0; i < size; i++) {
+    entries.push_back({keys[i], static_cast<uint32_t>(i + 1)});
+  }
+  auto queries = makeQueries(keys, 1 << 18, 1);
+
+  using Clock = std::chrono::steady_clock;
+  auto start = Clock::now();
+  auto blob = cexpr::serializeHashMap<uint32_t>(entries);
+  double serializeMs =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  char path[] = "/tmp/cexpr_bench_mapped.XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0 || write(fd, blob.data(), blob.size()) !=
+                    static_cast<ssize_t>(blob.size())) {
+    std::printf("cannot write %s\n", path);
+    return;
+  }
+  close(fd);
+
+  start = Clock::now();
+  std::unordered_map<std::string, uint32_t> unordered;
+  for (const auto& entry : entries) {
+    unordered.emplace(entry.first, entry.second);
+  }
+  double fillMs =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  start = Clock::now();
+  cexpr::MappedFile file(path);
+  cexpr::MappedHashMap<uint32_t> mapped(file.data(), file.size());
+  sink = mapped.get(queries[0]);
+  double openMs =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  unlink(path);
+
+  std::printf("%zu keys, %zu byte blob serialized in %.1f ms\n", size,
+              blob.size(), serializeMs);
+  std::printf("%-22s %9.3f ms startup\n", "std::unordered_map", fillMs);
+  std::printf("%-22s %9.3f ms startup\n", "MappedHashMap", openMs);
+  report("std::unordered_map", size, nsPerOp(queries.size(), [&] {
+           uintptr_t sum = 0;
+           for (const char* query : queries) {
+             auto it = unordered.find(query);
+             sum += it == unordered.end() ? 0 : it->second;
+           }
+           sink = sum;
+         }));
+  report("MappedHashMap", size, nsPerOp(queries.size(), [&] {
+           uintptr_t sum = 0;
+           for (const char* query : queries) {
+             sum += mapped.get(query);
+           }
+           sink = sum;
+         }));
+}
+
+// a runtime built table owning its blob, as a config reload makes them
+struct ReloadedTable {
+  explicit ReloadedTable(std::vector<char> data)
+      : blob(std::move(data)), map(blob.data(), blob.size()) {}
+
+  uint32_t get(const char* key) const { return map.get(key); }
+
+  std::vector<char> blob;
+  cexpr::MappedHashMap<uint32_t> map;
+};
+
+// readers look up keys for a while, with or without a writer publishing
+// a fresh copy of the table the whole time. lookup does one lookup
+// through the table under test, publish one swap
+template <typename Lookup, typename Publish>
+void benchSwapping(const char* name, size_t readers, bool swapping,
+                   const std::vector<const char*>& queries,
+                   const Lookup& lookup, const Publish& publish) {
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> reads{0};
+  std::atomic<uint64_t> swaps{0};
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < readers; i++) {
+    threads.emplace_back([&, i] {
+      uint64_t done = 0;
+      uintptr_t sum = 0;
+      for (size_t q = i; !stop.load(std::memory_order_relaxed);
+           q = (q + 1) % queries.size()) {
+        sum += lookup(queries[q]);
+        done++;
+      }
+      sink = sum;
+      reads += done;
+    });
+  }
+  std::thread writer;
+  if (swapping) {
+    writer = std::thread([&] {
+      while (!stop.load(std::memory_order_relaxed)) {
+        publish();
+        swaps++;
+      }
+    });
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (writer.joinable()) {
+    writer.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  std::printf("%-22s %2zu readers %-9s %8.2f M reads/s %8.0f swaps/s\n",
+              name, readers, swapping ? "swapping" : "steady",
+              reads / seconds / 1e6, swaps / seconds);
+}
+
+// TableHandle against a shared_mutex around a shared_ptr and the atomic
+// shared_ptr functions, which libstdc++ implements with a lock pool
+void benchSwap() {
+  constexpr size_t size = 1000;
+  auto keys = makeKeys(size, 24, size);
+  std::vector<std::pair<std::string, uint32_t>> entries;
+  for (size_t i = 0; i < size; i++) {
+    entries.push_back({keys[i], static_cast<uint32_t>(i + 1)});
+  }
+  auto blob = cexpr::serializeHashMap<uint32_t>(entries);
+  auto queries = makeQueries(keys, 1 << 16, 1);
+  // the writer gets a core of its own where there are enough
+  size_t many = std::max<size_t>(std::thread::hardware_concurrency(), 4) - 1;
+
+  for (size_t readers : {size_t(1), many}) {
+    for (bool swapping : {false, true}) {
+      cexpr::TableHandle<ReloadedTable> handle(
+          std::make_unique<ReloadedTable>(blob));
+      benchSwapping(
+          "TableHandle", readers, swapping, queries,
+          [&](const char* key) { return handle.get(key); },
+          [&] { handle.publish(std::make_unique<ReloadedTable>(blob)); });
+
+      std::shared_mutex mutex;
+      auto locked = std::make_shared<const ReloadedTable>(blob);
+      benchSwapping(
+          "shared_mutex", readers, swapping, queries,
+          [&](const char* key) {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            return locked->get(key);
+          },
+          [&] {
+            auto fresh = std::make_shared<const ReloadedTable>(blob);
+            std::unique_lock<std::shared_mutex> lock(mutex);
+            locked.swap(fresh);
+          });
+
+      auto shared = std::make_shared<const ReloadedTable>(blob);
+      benchSwapping(
+          "atomic shared_ptr", readers, swapping, queries,
+          [&](const char* key) { return std::atomic_load(&shared)->get(key); },
+          [&] {
+            std::atomic_store(&shared,
+                              std::make_shared<const ReloadedTable>(blob));
+          });
+    }
+  }
+}
+
+void reportSort(const char* name, size_t size, double ns) {
+  std::printf("%-22s %9zu elements %8.2f ns/element\n", name, size, ns);
+}
+
+// cexpr sorts against the standard library on random integers
+void benchSort(size_t size) {
+  std::mt19937 rng(static_cast<uint32_t>(size));
+  std::vector<uint32_t> input(size);
+  for (auto& val : input) {
+    val = rng();
+  }
+  std::vector<uint32_t> work(size);
+  std::vector<uint32_t> scratch(size);
+
+  reportSort("std::sort", size, nsPerOp(size, [&] {
+               work = input;
+               std::sort(work.begin(), work.end());
+             }));
+  reportSort("cexpr::sort", size, nsPerOp(size, [&] {
+               work = input;
+               cexpr::sort(work.begin(), work.end());
+             }));
+  reportSort("std::stable_sort", size, nsPerOp(size, [&] {
+               work = input;
+               std::stable_sort(work.begin(), work.end());
+             }));
+  reportSort("cexpr::stable_sort", size, nsPerOp(size, [&] {
+               work = input;
+               cexpr::stable_sort(work.begin(), work.end(), scratch.begin());
+             }));
+}
+
+// FlatMap's eytzinger search against binary search over the sorted array
+template <size_t size>
+void benchFlatMap() {
+  using Pairs64 = std::array<std::pair<uint64_t, uint64_t>, size>;
+  std::mt19937_64 rng(size);
+  auto pairs = std::make_unique<Pairs64>();
+  for (auto& pair : *pairs) {
+    pair = {rng(), rng()};
+  }
+  auto map = std::make_unique<cexpr::FlatMap<size, uint64_t, uint64_t>>(*pairs);
+  auto sorted = std::make_unique<std::array<uint64_t, size>>();
+  for (size_t i = 0; i < size; i++) {
+    (*sorted)[i] = (*pairs)[i].first;
+  }
+  std::sort(sorted->begin(), sorted->end());
+
+  // half of the queries hit
+  std::vector<uint64_t> queries(1 << 16);
+  for (auto& query : queries) {
+    query = rng() % 2 ? (*pairs)[rng() % size].first : rng();
+  }
+
+  report("FlatMap::lower_bound", size, nsPerOp(queries.size(), [&] {
+           uintptr_t sum = 0;
+           for (uint64_t query : queries) {
+             sum += map->lower_bound(query);
+           }
+           sink = sum;
+         }));
+  report("std::lower_bound", size, nsPerOp(queries.size(), [&] {
+           uintptr_t sum = 0;
+           for (uint64_t query : queries) {
+             sum += std::lower_bound(sorted->begin(), sorted->end(), query) -
+                    sorted->begin();
+           }
+           sink = sum;
+         }));
+  report("cexpr::lower_bound", size, nsPerOp(queries.size(), [&] {
+           uintptr_t sum = 0;
+           for (uint64_t query : queries) {
+             sum += cexpr::lower_bound(sorted->begin(), sorted->end(), query) -
+                    sorted->begin();
+           }
+           sink = sum;
+         }));
+}
+
+void reportScan(const char* name, size_t size, double ns) {
+  std::printf("%-28s %9zu elements %8.3f ns/element\n", name, size, ns);
+}
+
+// the runtime kernels behind the scanning algorithms against the standard
+// library. the values never match, so every call reads the whole range
+template <typename T>
+void benchScan(const char* type, size_t size) {
+  std::vector<T> data(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = static_cast<T>(i % 2);
+  }
+  const std::vector<T> copy = data;
+  const T* first = data.data();
+  const T* last = first + size;
+  auto isThree = [](const T& val) { return val == 3; };
+  std::printf("-- %s\n", type);
+
+  reportScan("std::count", size, nsPerOp(size, [&] {
+               sink = std::count(first, last, T(3));
+             }));
+  reportScan("cexpr::count", size, nsPerOp(size, [&] {
+               sink = cexpr::count(first, last, T(3));
+             }));
+  reportScan("std::find", size, nsPerOp(size, [&] {
+               sink = std::find(first, last, T(3)) - first;
+             }));
+  reportScan("cexpr::find", size, nsPerOp(size, [&] {
+               sink = cexpr::find(first, last, T(3)) - first;
+             }));
+  reportScan("std::find_if", size, nsPerOp(size, [&] {
+               sink = std::find_if(first, last, isThree) - first;
+             }));
+  reportScan("cexpr::find_if", size, nsPerOp(size, [&] {
+               sink = cexpr::find_if(first, last, isThree) - first;
+             }));
+  reportScan("std::equal", size, nsPerOp(size, [&] {
+               sink = std::equal(first, last, copy.data(),
+                                 copy.data() + size);
+             }));
+  reportScan("cexpr::equal", size, nsPerOp(size, [&] {
+               sink = cexpr::equal(first, last, copy.data(),
+                                   copy.data() + size);
+             }));
+  reportScan("std::adjacent_find", size, nsPerOp(size, [&] {
+               sink = std::adjacent_find(first, last) - first;
+             }));
+  reportScan("cexpr::adjacent_find", size, nsPerOp(size, [&] {
+               sink = cexpr::adjacent_find(first, last) - first;
+             }));
+}
+
+// reductions and scans against <numeric> on in cache buffers
+template <typename T>
+void benchNumeric(const char* type, size_t size) {
+  std::vector<T> data(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = static_cast<T>(i % 13);
+  }
+  std::vector<T> out(size);
+  const T* first = data.data();
+  const T* last = first + size;
+  volatile T result;
+  std::printf("-- %s\n", type);
+
+  reportScan("std::accumulate", size, nsPerOp(size, [&] {
+               result = std::accumulate(first, last, T(0));
+             }));
+  reportScan("cexpr::accumulate", size, nsPerOp(size, [&] {
+               result = cexpr::accumulate(first, last, T(0));
+             }));
+  reportScan("std::reduce", size, nsPerOp(size, [&] {
+               result = std::reduce(first, last, T(0));
+             }));
+  reportScan("cexpr::reduce", size, nsPerOp(size, [&] {
+               result = cexpr::reduce(first, last, T(0));
+             }));
+  reportScan("cexpr::reduce(par)", size, nsPerOp(size, [&] {
+               result = cexpr::reduce(cexpr::execution::par, first, last,
+                                      T(0));
+             }));
+  reportScan("std::transform_reduce", size, nsPerOp(size, [&] {
+               result = std::transform_reduce(first, last, first, T(0));
+             }));
+  reportScan("cexpr::transform_reduce", size, nsPerOp(size, [&] {
+               result = cexpr::transform_reduce(first, last, first, T(0));
+             }));
+  reportScan("std::inclusive_scan", size, nsPerOp(size, [&] {
+               std::inclusive_scan(first, last, out.data());
+               result = out.back();
+             }));
+  reportScan("cexpr::inclusive_scan", size, nsPerOp(size, [&] {
+               cexpr::inclusive_scan(first, last, out.data());
+               result = out.back();
+             }));
+  reportScan("std::exclusive_scan", size, nsPerOp(size, [&] {
+               std::exclusive_scan(first, last, out.data(), T(0));
+               result = out.back();
+             }));
+  reportScan("cexpr::exclusive_scan", size, nsPerOp(size, [&] {
+               cexpr::exclusive_scan(first, last, out.data(), T(0));
+               result = out.back();
+             }));
+}
+
+// the execution policy overloads on one large range, a find_if match in
+// the first part shows how fast the other parts give up
+template <typename Policy>
+void benchPolicy(const char* name, Policy policy,
+                 const std::vector<uint32_t>& data,
+                 const std::array<uint32_t, 1 << 22>& input) {
+  size_t size = data.size();
+  const uint32_t* first = data.data();
+  const uint32_t* last = first + size;
+  uint32_t early = static_cast<uint32_t>(size / 64);
+  auto isLast = [size](const uint32_t& val) { return val == size - 1; };
+  auto isEarly = [early](const uint32_t& val) { return val == early; };
+  std::string prefix = std::string(name) + " ";
+
+  reportScan((prefix + "count").c_str(), size, nsPerOp(size, [&] {
+               sink = cexpr::count(policy, first, last, 3U);
+             }));
+  reportScan((prefix + "find_if last").c_str(), size, nsPerOp(size, [&] {
+               sink = cexpr::find_if(policy, first, last, isLast) - first;
+             }));
+  reportScan((prefix + "find_if early").c_str(), size, nsPerOp(size, [&] {
+               sink = cexpr::find_if(policy, first, last, isEarly) - first;
+             }));
+  reportScan((prefix + "for_each_array").c_str(), input.size(),
+             nsPerOp(input.size(), [&] {
+               auto out = cexpr::for_each_array(
+                   policy, input, [](const uint32_t& val) {
+                     return val * 2654435761u >> 7;
+                   });
+               sink = out[input.size() / 2];
+             }));
+}
+
+void benchParallel() {
+  std::vector<uint32_t> data(1 << 24);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<uint32_t>(i);
+  }
+  static std::array<uint32_t, 1 << 22> input{};
+  std::printf("%zu threads\n", cexpr::ThreadPool::global().size() + 1);
+  benchPolicy("seq", cexpr::execution::seq, data, input);
+  benchPolicy("par", cexpr::execution::par, data, input);
+  benchPolicy("par_unseq", cexpr::execution::par_unseq, data, input);
+}
+
+struct Group {
+  const char* name;
+  void (*run)();
+};
+
+const Group groups[] = {
+    {"lookup",
+     [] {
+       benchLookups<10>();
+       benchLookups<100>();
+       benchLookups<1000>();
+       benchLookups<10000>();
+       benchLookups<100000>();
+     }},
+    {"batch",
+     [] {
+       benchGetMany<1 << 10>();
+       benchGetMany<1 << 17>();
+     }},
+    {"layout",
+     [] {
+       benchLayouts<1 << 10>();
+       benchLayouts<1 << 17>();
+     }},
+    {"switch", benchSwitch},
+    {"enum", benchEnum},
+    {"mapped",
+     [] {
+       benchMapped<1000>();
+       benchMapped<100000>();
+     }},
+    {"swap", benchSwap},
+    {"flatmap",
+     [] {
+       benchFlatMap<1000>();
+       benchFlatMap<10000>();
+       benchFlatMap<100000>();
+       benchFlatMap<1000000>();
+     }},
+    {"sort",
+     [] {
+       benchSort(1000);
+       benchSort(1000000);
+     }},
+    {"simd",
+     [] {
+       benchScan<uint8_t>("uint8_t", 1 << 20);
+       benchScan<uint32_t>("uint32_t", 1 << 20);
+       benchScan<uint64_t>("uint64_t", 1 << 20);
+     }},
+    {"parallel", benchParallel},
+    {"numeric",
+     [] {
+       benchNumeric<uint32_t>("uint32_t", 1 << 16);
+       benchNumeric<uint64_t>("uint64_t", 1 << 16);
+       benchNumeric<float>("float", 1 << 16);
+       benchNumeric<double>("double", 1 << 16);
+     }},
+};
+
+}
+
+int main(int argc, char** argv) {
+  std::vector<std::string> selected(argv + 1, argv + argc);
+  runWithStack(size_t(1) << 30, [&] {
+    for (const auto& group : groups) {
+      if (selected.empty() || std::find(selected.begin(), selected.end(),
+                                        group.name) != selected.end()) {
+        std::printf("== %s\n", group.name);
+        group.run();
+      }
+    }
+  });
+  return 0;
+}
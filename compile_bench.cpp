@@ -0,0 +1,365 @@
+// compile time benchmark for the constexpr table builders. generates
+// translation units with synthetic key sets, compiles each one and
+// reports wall time, peak compiler memory and, with --steps, the smallest
+// constexpr step limit that still compiles it:
+//   g++ -std=c++17 -O2 compile_bench.cpp -o compile_bench
+//   ./compile_bench [--steps] [--budget compile_budget.txt] [sizes...]
+// CXX picks the compiler, gcc and clang are both understood. gcc also
+// writes -ftime-report and clang -ftime-trace next to every generated file.
+// with --budget the exit code is 1 when a subject takes more seconds, MB
+// or constexpr ops than the file allows
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::string cxx = "g++";
+  std::string includeDir;
+  std::string outDir;
+  std::string budget;
+  bool steps = false;
+  bool clang = false;
+  std::vector<size_t> sizes;
+};
+
+struct Run {
+  bool ok;
+  double seconds;
+  long peakKb;
+};
+
+std::string dirName(const std::string& path) {
+  size_t slash = path.rfind('/');
+  return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+// runs argv with its output in logPath and reports the child's own usage.
+// a child that cannot be started or waited for counts as failed
+Run runCompiler(const std::vector<std::string>& args,
+                const std::string& logPath) {
+  std::vector<char*> argv;
+  for (const auto& arg : args) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  if (pid < 0) {
+    std::perror("fork");
+    return {false, 0, 0};
+  }
+  if (pid == 0) {
+    int fd = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0 ||
+        dup2(fd, STDERR_FILENO) < 0) {
+      std::perror(logPath.c_str());
+      _exit(127);
+    }
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+  int status = 0;
+  struct rusage usage {};
+  pid_t waited;
+  do {
+    waited = wait4(pid, &status, 0, &usage);
+  } while (waited < 0 && errno == EINTR);
+  if (waited < 0) {
+    std::perror("wait4");
+    return {false, 0, 0};
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return {WIFEXITED(status) && WEXITSTATUS(status) == 0,
+          std::chrono::duration<double>(elapsed).count(), usage.ru_maxrss};
+}
+
+std::string keyArray(size_t size) {
+  std::ostringstream out;
+  out << "constexpr std::array<std::pair<const char*, uint32_t>, " << size
+      << "> keys{{\n";
+  for (size_t i = 0; i < size; i++) {
+    out << "    {\"/route/" << i << "/item" << i * 7919 % 10007 << "\", "
+        << i + 1 << "},\n";
+  }
+  out << "}};\n";
+  return out.str();
+}
+
+std::string valueArray(size_t size) {
+  std::mt19937 rng(static_cast<uint32_t>(size));
+  std::ostringstream out;
+  out << "constexpr std::array<uint32_t, " << size << "> values{{";
+  for (size_t i = 0; i < size; i++) {
+    out << rng() << "u,";
+  }
+  out << "}};\n";
+  return out.str();
+}
+
+struct Subject {
+  const char* name;
+  std::string (*source)(size_t);
+};
+
+const char* header =
+    "#include <cstdint>\n"
+    "#include \"const_hashmap.h\"\n"
+    "#include \"sharded_hashmap.h\"\n"
+    "struct Cmp {\n"
+    "  constexpr int operator()(const char* l, const char* r) const {\n"
+    "    if (r == nullptr) return 1;\n"
+    "    for (; *l != '\\0' || *r != '\\0'; l++, r++) {\n"
+    "      if (*l != *r) return *l - *r;\n"
+    "    }\n"
+    "    return 0;\n"
+    "  }\n"
+    "};\n";
+
+// baseline only parses the key array, the others add one builder each
+const Subject subjects[] = {
+    {"baseline",
+     [](size_t size) { return std::string(header) + keyArray(size); }},
+    {"mergeSort",
+     [](size_t size) {
+       return std::string(header) + valueArray(size) +
+              "constexpr auto sorted = cexpr::mergeSort(values);\n"
+              "static_assert(sorted.front() <= sorted.back(), \"sorted\");\n";
+     }},
+    {"getPerfectHashSize",
+     [](size_t size) {
+       return std::string(header) + keyArray(size) +
+              "constexpr auto mapSize =\n"
+              "    cexpr::getPerfectHashSize<cexpr::fnv1aHasher>(keys);\n"
+              "static_assert(mapSize >= keys.size(), \"fits\");\n";
+     }},
+    {"HashMap",
+     [](size_t size) {
+       return std::string(header) + keyArray(size) +
+              "constexpr auto mapSize =\n"
+              "    cexpr::getPerfectHashSize<cexpr::fnv1aHasher>(keys);\n"
+              "constexpr cexpr::HashMap<keys.size(), mapSize, const char*,\n"
+              "    uint32_t, Cmp, cexpr::fnv1aHasher> map(keys);\n"
+              "static_assert(map.get(keys[0].first) == 1, \"found\");\n";
+     }},
+    // seed searches in two halves, the step limit is the one of the
+    // largest constant expression
+    {"ShardedHashMap",
+     [](size_t size) {
+       return std::string(header) + keyArray(size) +
+              "constexpr size_t shards = cexpr::getShardCount(keys.size());\n"
+              "constexpr auto low = cexpr::getShardTables<\n"
+              "    cexpr::fnv1aHasher, shards>(keys, 0, shards / 2);\n"
+              "constexpr auto high = cexpr::getShardTables<\n"
+              "    cexpr::fnv1aHasher, shards>(keys, shards / 2, shards);\n"
+              "constexpr cexpr::ShardedHashMap<keys.size(), shards,\n"
+              "    const char*, uint32_t, Cmp, cexpr::fnv1aHasher>\n"
+              "    map(keys, cexpr::mergeShardTables(low, high));\n"
+              "static_assert(map.get(keys[0].first) == 1, \"found\");\n";
+     }},
+};
+
+std::vector<std::string> compileArgs(const Options& opts,
+                                     const std::string& src,
+                                     uint64_t stepLimit, bool report) {
+  std::vector<std::string> args = {opts.cxx,
+                                   "-std=c++17",
+                                   "-I" + opts.includeDir,
+                                   "-c",
+                                   src,
+                                   "-o",
+                                   src + ".o"};
+  if (opts.clang) {
+    args.push_back("-fconstexpr-steps=" + std::to_string(stepLimit));
+    args.push_back("-ftemplate-depth=100000");
+    if (report) {
+      args.push_back("-ftime-trace");
+    }
+  } else {
+    args.push_back("-fconstexpr-ops-limit=" + std::to_string(stepLimit));
+    args.push_back("-fconstexpr-loop-limit=2147483647");
+    args.push_back("-ftemplate-depth=100000");
+    if (report) {
+      args.push_back("-ftime-report");
+    }
+  }
+  return args;
+}
+
+// smallest step limit that still compiles, by bisection
+uint64_t findStepLimit(const Options& opts, const std::string& src) {
+  uint64_t lo = 1;
+  uint64_t hi = uint64_t(1) << 40;
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if (runCompiler(compileArgs(opts, src, mid, false), src + ".steps.log")
+            .ok) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+struct Budget {
+  std::string subject;
+  size_t size;
+  double seconds;
+  long peakMb;
+  // constexpr ops gcc may take, 0 leaves them unchecked
+  uint64_t steps;
+};
+
+// lines of "subject size seconds peak_mb steps", # starts a comment
+std::vector<Budget> readBudget(const std::string& path) {
+  std::vector<Budget> budget;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    Budget entry;
+    if (fields >> entry.subject >> entry.size >> entry.seconds >>
+        entry.peakMb >> entry.steps) {
+      budget.push_back(entry);
+    }
+  }
+  return budget;
+}
+
+// the step budget holds when the file compiles with it as the limit, or
+// when the limit --steps found is within it. clang counts its steps
+// differently, so the budgets only bind gcc
+bool withinSteps(const Options& opts, const std::string& src,
+                 uint64_t measured, uint64_t allowed) {
+  if (allowed == 0 || opts.clang) {
+    return true;
+  }
+  if (measured != 0) {
+    return measured <= allowed;
+  }
+  return runCompiler(compileArgs(opts, src, allowed, false),
+                     src + ".budget.log")
+      .ok;
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options opts;
+  opts.includeDir = dirName(__FILE__);
+  if (const char* cxx = std::getenv("CXX")) {
+    opts.cxx = cxx;
+  }
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--steps") {
+      opts.steps = true;
+    } else if (arg == "--budget" && i + 1 < argc) {
+      opts.budget = argv[++i];
+    } else if (arg == "--include" && i + 1 < argc) {
+      opts.includeDir = argv[++i];
+    } else if (arg == "--out" && i + 1 < argc) {
+      opts.outDir = argv[++i];
+    } else {
+      opts.sizes.push_back(std::stoul(arg));
+    }
+  }
+  if (opts.sizes.empty()) {
+    opts.sizes = {100, 1000, 10000};
+  }
+  if (opts.outDir.empty()) {
+    char tmpl[] = "/tmp/cexpr_compile_bench.XXXXXX";
+    if (mkdtemp(tmpl) == nullptr) {
+      std::perror("mkdtemp");
+      std::exit(2);
+    }
+    opts.outDir = tmpl;
+  }
+  char* absolute = realpath(opts.includeDir.c_str(), nullptr);
+  if (absolute != nullptr) {
+    opts.includeDir = absolute;
+    std::free(absolute);
+  }
+  Run version = runCompiler({opts.cxx, "--version"},
+                            opts.outDir + "/version.log");
+  std::ifstream versionLog(opts.outDir + "/version.log");
+  std::string firstLine;
+  std::getline(versionLog, firstLine);
+  opts.clang = version.ok && firstLine.find("clang") != std::string::npos;
+  return opts;
+}
+
+}
+
+int main(int argc, char** argv) {
+  Options opts = parseOptions(argc, argv);
+  std::vector<Budget> budget;
+  if (!opts.budget.empty()) {
+    budget = readBudget(opts.budget);
+    if (budget.empty()) {
+      std::fprintf(stderr, "no budget in %s\n", opts.budget.c_str());
+      return 2;
+    }
+  }
+
+  std::printf("compiler %s, files in %s\n", opts.cxx.c_str(),
+              opts.outDir.c_str());
+  std::printf("%-20s %7s %9s %9s %14s\n", "subject", "keys", "seconds",
+              "peak MB", "constexpr ops");
+  bool overBudget = false;
+  for (size_t size : opts.sizes) {
+    for (const auto& subject : subjects) {
+      std::string src = opts.outDir + "/" + subject.name + "_" +
+                        std::to_string(size) + ".cpp";
+      std::ofstream file(src);
+      file << subject.source(size);
+      file.close();
+      if (!file) {
+        std::fprintf(stderr, "cannot write %s\n", src.c_str());
+        return 2;
+      }
+
+      Run run = runCompiler(compileArgs(opts, src, uint64_t(1) << 40, true),
+                            src + ".log");
+      uint64_t measured = 0;
+      std::string steps = "-";
+      if (!run.ok) {
+        steps = "failed, see .log";
+      } else if (opts.steps) {
+        measured = findStepLimit(opts, src);
+        steps = std::to_string(measured);
+      }
+      long peakMb = run.peakKb / 1024;
+      std::printf("%-20s %7zu %9.2f %9ld %14s\n", subject.name, size,
+                  run.seconds, peakMb, steps.c_str());
+
+      for (const auto& entry : budget) {
+        if (entry.subject == subject.name && entry.size == size &&
+            (!run.ok || run.seconds > entry.seconds ||
+             peakMb > entry.peakMb ||
+             !withinSteps(opts, src, measured, entry.steps))) {
+          std::printf("  over budget: %.2f s / %ld MB / %llu ops allowed\n",
+                      entry.seconds, entry.peakMb,
+                      static_cast<unsigned long long>(entry.steps));
+          overBudget = true;
+        }
+      }
+    }
+  }
+  return overBudget ? 1 : 0;
+}
@@ -1,43 +1,247 @@
 #pragma once
 #include <array>
-#include <cmath>
+#include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
 #include <utility>
+#include <vector>
+#if __has_include(<span>)
+#include <span>
+#endif
 #include "./algorithm.h"
+#include "./instrumentation.h"
 
 namespace cexpr {
 
 namespace {
 constexpr uint32_t offset = 0x811C9DC5;
 constexpr uint32_t prime = 0x01000193;
+
+constexpr uint32_t byteOf(char c) {
+  return static_cast<uint8_t>(c);
+}
 }
 
-constexpr uint32_t fnv1(const char* const& csrc) {
-  uint32_t start = offset;
+// seed 0 is the plain hash. any other seed also multiplies the state by
+// an odd factor every byte, otherwise reordered keys would collide for
+// every seed. bytes are hashed unsigned, so a table built where char is
+// signed still finds its keys where it is not
+constexpr uint32_t fnv1(const char* const& csrc, uint32_t seed = 0) {
+  uint32_t start = offset ^ seed;
+  uint32_t factor = seed * 2 + 1;
   const char* src = csrc;
   while (*src != '\0') {
-    start = (static_cast<uint32_t>(*src) * prime) ^ start;
+    start = ((byteOf(*src) * prime) ^ start) * factor;
     src++;
   }
   return start;
 }
 
+// the same hash over a slice that need not be NUL terminated
+constexpr uint32_t fnv1(std::string_view src, uint32_t seed = 0) {
+  uint32_t start = offset ^ seed;
+  uint32_t factor = seed * 2 + 1;
+  for (char c : src) {
+    start = ((byteOf(c) * prime) ^ start) * factor;
+  }
+  return start;
+}
+
+// hashers take the seed the perfect hash builder picked, as the second
+// argument. the std::string_view overloads hash a slice exactly like the
+// NUL terminated key, which HashMap::get(std::string_view) relies on
 struct fnv1Hasher {
-  constexpr uint32_t operator()(const char* const& csrc) { return fnv1(csrc); }
+  static constexpr const char* name = "fnv1";
+
+  constexpr uint32_t operator()(const char* const& csrc, uint32_t seed = 0) {
+    return fnv1(csrc, seed);
+  }
+
+  constexpr uint32_t operator()(std::string_view src, uint32_t seed = 0) {
+    return fnv1(src, seed);
+  }
 };
 
-constexpr uint32_t fnv1a(const char* const& csrc) {
+constexpr uint32_t fnv1a(const char* const& csrc, uint32_t seed = 0) {
   const char* src = csrc;
-  uint32_t start = offset;
+  uint32_t start = offset ^ seed;
   while (*src != '\0') {
-    start = (static_cast<uint32_t>(*src) ^ start) * prime;
+    start = (byteOf(*src) ^ start) * prime;
     src++;
   }
   return start;
 }
 
+constexpr uint32_t fnv1a(std::string_view src, uint32_t seed = 0) {
+  uint32_t start = offset ^ seed;
+  for (char c : src) {
+    start = (byteOf(c) ^ start) * prime;
+  }
+  return start;
+}
+
+struct fnv1aHasher {
+  static constexpr const char* name = "fnv1a";
+
+  constexpr uint32_t operator()(const char* const& csrc, uint32_t seed = 0) {
+    return fnv1a(csrc, seed);
+  }
+
+  constexpr uint32_t operator()(std::string_view src, uint32_t seed = 0) {
+    return fnv1a(src, seed);
+  }
+};
+
+namespace {
+constexpr uint64_t wordPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t wordPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t wordPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t wordPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t wordPrime5 = 0x27D4EB2F165667C5ULL;
+}
+
+constexpr size_t length(const char* src) {
+  if (!is_constant_evaluated()) {
+    return std::strlen(src);
+  }
+  size_t len = 0;
+  while (src[len] != '\0') {
+    len++;
+  }
+  return len;
+}
+
+constexpr bool equalChars(const char* lhs, const char* rhs, size_t len) {
+  if (!is_constant_evaluated()) {
+    return len == 0 || std::memcmp(lhs, rhs, len) == 0;
+  }
+  for (size_t i = 0; i < len; i++) {
+    if (lhs[i] != rhs[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+constexpr uint64_t rotl(uint64_t val, int bits) {
+  return (val << bits) | (val >> (64 - bits));
+}
+
+// little endian load of `bytes` bytes, a single unaligned load at runtime
+template <size_t bytes>
+constexpr uint64_t loadWord(const char* src) {
+  static_assert(bytes == 4 || bytes == 8, "only 4 and 8 byte words");
+  if (!is_constant_evaluated()) {
+    std::conditional_t<bytes == 8, uint64_t, uint32_t> word = 0;
+    std::memcpy(&word, src, bytes);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    if constexpr (bytes == 8) {
+      word = __builtin_bswap64(word);
+    } else {
+      word = __builtin_bswap32(word);
+    }
+#endif
+    return word;
+  }
+  uint64_t word = 0;
+  for (size_t i = 0; i < bytes; i++) {
+    word |= static_cast<uint64_t>(static_cast<uint8_t>(src[i])) << (i * 8);
+  }
+  return word;
+}
+
+// xxhash64 style single lane hash, consumes 8 bytes per step instead of
+// one. gives the same value at compile time and at runtime
+constexpr uint64_t wordHash(const char* src, size_t len, uint64_t seed = 0) {
+  uint64_t h = seed + wordPrime5 + len;
+  for (; len >= 8; len -= 8, src += 8) {
+    uint64_t k = rotl(loadWord<8>(src) * wordPrime2, 31) * wordPrime1;
+    h = rotl(h ^ k, 27) * wordPrime1 + wordPrime4;
+  }
+  if (len >= 4) {
+    h ^= loadWord<4>(src) * wordPrime1;
+    h = rotl(h, 23) * wordPrime2 + wordPrime3;
+    len -= 4;
+    src += 4;
+  }
+  for (; len > 0; len--, src++) {
+    h ^= static_cast<uint8_t>(*src) * wordPrime5;
+    h = rotl(h, 11) * wordPrime1;
+  }
+  h ^= h >> 33;
+  h *= wordPrime2;
+  h ^= h >> 29;
+  h *= wordPrime3;
+  h ^= h >> 32;
+  return h;
+}
+
+constexpr uint64_t wordHash(const char* const& csrc) {
+  return wordHash(csrc, length(csrc));
+}
+
+// drop in replacement for fnv1Hasher and fnv1aHasher
+struct wordHasher {
+  static constexpr const char* name = "wordHash";
+
+  constexpr uint32_t operator()(std::string_view src, uint32_t seed = 0) {
+    uint64_t h = wordHash(src.data(), src.size(), seed);
+    return static_cast<uint32_t>(h ^ (h >> 32));
+  }
+
+  constexpr uint32_t operator()(const char* const& csrc, uint32_t seed = 0) {
+    return (*this)(std::string_view(csrc, length(csrc)), seed);
+  }
+};
+
+// comparator for NUL terminated keys, zero when equal. empty slots hold
+// a null key, which never equals a lookup
+struct CStringComparator {
+  constexpr int operator()(const char* lhs, const char* rhs) const {
+    if (lhs == nullptr || rhs == nullptr) {
+      return lhs == rhs ? 0 : 1;
+    }
+    if (!is_constant_evaluated()) {
+      return std::strcmp(lhs, rhs);
+    }
+    for (; *lhs != '\0' && *lhs == *rhs; lhs++, rhs++) {
+    }
+    return static_cast<unsigned char>(*lhs) - static_cast<unsigned char>(*rhs);
+  }
+};
+
+// hashers without a seed parameter only get seed 0
+template <typename Hash, typename Key>
+constexpr uint32_t seededHash(const Key& key, uint32_t seed) {
+  Hash hasher;
+  if constexpr (std::is_invocable_v<Hash&, const Key&, uint32_t>) {
+    return hasher(key, seed);
+  } else {
+    return hasher(key);
+  }
+}
+
+// Hash::name when the hasher has one
+template <typename Hash, typename = void>
+struct HashName {
+  static constexpr const char* value = "unnamed";
+};
+
+template <typename Hash>
+struct HashName<Hash, std::void_t<decltype(Hash::name)>> {
+  static constexpr const char* value = Hash::name;
+};
+
+template <typename Hash, typename Key>
+constexpr uint32_t getSeedCount() {
+  return std::is_invocable_v<Hash&, const Key&, uint32_t> ? 256 : 1;
+}
+
 template <size_t cbegin, size_t bufSize, typename T, size_t size>
 constexpr std::array<T, bufSize> copyRange(const std::array<T, size> full) {
   size_t begin = cbegin;
@@ -93,16 +297,14 @@ constexpr std::array<T, size1 + size2> merge(const std::array<T, size1>& lhs,
   return buf;
 }
 
+// sorted copy of arr, stable, with a single scratch array and no
+// recursion
 template <typename T, size_t size>
 constexpr std::array<T, size> mergeSort(const std::array<T, size> arr) {
-  if (size <= 1) {
-    return arr;
-  }
-
-  constexpr size_t middle = size / 2;
-  auto left = mergeSort(copyRange<0, middle>(arr));
-  auto right = mergeSort(copyRange<middle, size - middle>(arr));
-  return merge<T, middle, size - middle>(left, right);
+  std::array<T, size> sorted = arr;
+  std::array<T, size> scratch{};
+  cexpr::stable_sort(sorted.begin(), sorted.end(), scratch.begin());
+  return sorted;
 }
 
 template <typename T, typename First = typename T::first_type,
@@ -111,82 +313,761 @@ constexpr First getFirst(const std::pair<First, Second>& pair) {
   return pair.first;
 }
 
-// hash all entries and try to find the best size
-template <typename Hash, typename T, size_t size>
-constexpr size_t getPerfectHashSize(const std::array<T, size>& buf) {
-  // first get all the hashes
-  Hash hasher;
-  auto keys = for_each_array(buf, getFirst<T>);
-  auto hashes = for_each_array(keys, hasher);
+// roughly two keys per bucket keeps the displacement search short while
+// the displacement array stays at about one byte per key
+constexpr size_t getBucketCount(size_t size) { return size / 2 + 1; }
+
+// murmur3 finalizer, spreads a key hash over the table differently for
+// every displacement value
+constexpr uint32_t displace(uint32_t hashVal, uint32_t displacement) {
+  uint32_t h = hashVal ^ (displacement * 0x9E3779B9u);
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35u;
+  h ^= h >> 16;
+  return h;
+}
+
+constexpr size_t getBucket(uint32_t hashVal, size_t bucketCount) {
+  return hashVal % bucketCount;
+}
+
+constexpr size_t getSlot(uint32_t hashVal, uint16_t displacement,
+                         size_t mapSize) {
+  return displace(hashVal, displacement) % mapSize;
+}
+
+// remainder by a divisor only known at runtime, without a division. exact
+// for every 32 bit dividend and divisor, see Lemire et al., "Faster
+// Remainder by Direct Computation". targets without a 128 bit multiply,
+// MSVC and 32 bit ones, take the plain remainder
+class FastMod {
+ public:
+  constexpr FastMod() = default;
+  constexpr explicit FastMod(uint32_t divisor)
+      : mul_(~uint64_t(0) / divisor + 1), divisor_(divisor) {}
+
+  constexpr uint32_t operator()(uint32_t val) const {
+#ifdef __SIZEOF_INT128__
+    uint64_t low = mul_ * val;
+    return static_cast<uint32_t>(
+        (static_cast<unsigned __int128>(low) * divisor_) >> 64);
+#else
+    return val % divisor_;
+#endif
+  }
+
+  constexpr uint32_t divisor() const { return divisor_; }
+
+ private:
+  uint64_t mul_ = 0;
+  uint32_t divisor_ = 1;
+};
+
+// scratch space for buildDisplacements
+template <size_t size, size_t bucketCount, size_t mapSize>
+struct DisplacementWorkspace {
+  std::array<size_t, bucketCount + 1> bucketStart{};
+  std::array<size_t, size> keyOrder{};
+  std::array<size_t, bucketCount> bucketOrder{};
+  std::array<size_t, size + 1> sizeStart{};
+  std::array<bool, mapSize> taken{};
+};
+
+// hash and displace: group the key hashes into buckets, then place the
+// buckets largest first, searching for the smallest displacement that
+// moves every key of the bucket into a free slot. each key is hashed
+// once by the caller, so the work is linear in the number of keys.
+// returns false when some bucket cannot be placed
+template <typename Hashes, typename Displacements, typename Workspace>
+constexpr bool buildDisplacements(const Hashes& hashes, size_t size,
+                                  Displacements& displacements,
+                                  size_t bucketCount, size_t mapSize,
+                                  Workspace& ws) {
+  for (size_t i = 0; i <= bucketCount; i++) {
+    ws.bucketStart[i] = 0;
+  }
+  for (size_t i = 0; i < size; i++) {
+    ws.bucketStart[getBucket(hashes[i], bucketCount) + 1]++;
+  }
+  for (size_t i = 0; i < bucketCount; i++) {
+    ws.bucketStart[i + 1] += ws.bucketStart[i];
+  }
 
-  // then try to find if there is a chance that not all
-  // of the hashes will get a cache collision
-  for (size_t i = 0; i < 2000; i++) {
-    size_t modBase = (size + i * 3) * 2.71828;
-    std::array<size_t, size> modded{};
-    for (int i = 0; i < size; i++) {
-      auto& ref = getRef(modded, i);
-      ref = getRef(hashes, i) % modBase;
+  // counting sort the keys by bucket, bucketOrder is the cursor for now
+  for (size_t i = 0; i < bucketCount; i++) {
+    ws.bucketOrder[i] = ws.bucketStart[i];
+  }
+  for (size_t i = 0; i < size; i++) {
+    size_t bucket = getBucket(hashes[i], bucketCount);
+    ws.keyOrder[ws.bucketOrder[bucket]++] = i;
+  }
+
+  // then counting sort the buckets by size, largest first
+  for (size_t i = 0; i <= size; i++) {
+    ws.sizeStart[i] = 0;
+  }
+  for (size_t i = 0; i < bucketCount; i++) {
+    ws.sizeStart[ws.bucketStart[i + 1] - ws.bucketStart[i]]++;
+  }
+  size_t pos = 0;
+  for (size_t i = size + 1; i > 0; i--) {
+    size_t cnt = ws.sizeStart[i - 1];
+    ws.sizeStart[i - 1] = pos;
+    pos += cnt;
+  }
+  for (size_t i = 0; i < bucketCount; i++) {
+    size_t bucketSize = ws.bucketStart[i + 1] - ws.bucketStart[i];
+    ws.bucketOrder[ws.sizeStart[bucketSize]++] = i;
+  }
+
+  for (size_t i = 0; i < mapSize; i++) {
+    ws.taken[i] = false;
+  }
+  for (size_t i = 0; i < bucketCount; i++) {
+    displacements[i] = 0;
+  }
+
+  for (size_t i = 0; i < bucketCount; i++) {
+    size_t bucket = ws.bucketOrder[i];
+    size_t begin = ws.bucketStart[bucket];
+    size_t end = ws.bucketStart[bucket + 1];
+    if (begin == end) {
+      // sorted by size, so the rest are empty as well
+      break;
     }
 
-    // if there are repeats, we need to increase modBase
-    // size, rehash everything and try again
+    // two keys with the same hash can never be separated
+    for (size_t j = begin; j < end; j++) {
+      for (size_t k = j + 1; k < end; k++) {
+        if (hashes[ws.keyOrder[j]] == hashes[ws.keyOrder[k]]) {
+          return false;
+        }
+      }
+    }
 
-    auto sorted = mergeSort(modded);
-    if (sorted.end() == adjacent_find(sorted.begin(), sorted.end())) {
-      return modBase;
+    bool placed = false;
+    for (uint32_t d = 0; d <= std::numeric_limits<uint16_t>::max(); d++) {
+      size_t j = begin;
+      for (; j < end; j++) {
+        size_t slot = getSlot(hashes[ws.keyOrder[j]], d, mapSize);
+        if (ws.taken[slot]) {
+          break;
+        }
+        ws.taken[slot] = true;
+      }
+      if (j == end) {
+        displacements[bucket] = static_cast<uint16_t>(d);
+        placed = true;
+        break;
+      }
+      // roll back the keys of this bucket that did fit
+      for (size_t k = begin; k < j; k++) {
+        ws.taken[getSlot(hashes[ws.keyOrder[k]], d, mapSize)] = false;
+      }
+    }
+    if (!placed) {
+      return false;
     }
   }
+  return true;
+}
 
-  return 0;
+template <typename Hash, typename Key, size_t size>
+constexpr std::array<uint32_t, size> getHashes(
+    const std::array<Key, size>& keys, uint32_t seed) {
+  std::array<uint32_t, size> hashes{};
+  for (size_t i = 0; i < size; i++) {
+    getRef(hashes, i) = seededHash<Hash>(keys[i], seed);
+  }
+  return hashes;
 }
 
-template <typename HashFunc, size_t dst, size_t src, typename Key,
-          typename Value>
-constexpr std::array<std::pair<Key, Value>, dst> transformWithHash(
-    const std::array<std::pair<Key, Value>, src>& srcArr) {
-  std::array<std::pair<Key, Value>, dst> dstArr{};
-  HashFunc hasher;
-  for (int i = 0; i < src; i++) {
-    size_t hashVal = hasher(srcArr[i].first);
-    size_t modded = hashVal % dst;
-    auto& ref = getRef(dstArr, modded);
-    ref.first = srcArr[i].first;
-    ref.second = srcArr[i].second;
+template <typename Hash, typename First, typename Second, size_t size>
+constexpr std::array<uint32_t, size> getHashes(
+    const std::array<std::pair<First, Second>, size>& buf, uint32_t seed) {
+  std::array<uint32_t, size> hashes{};
+  for (size_t i = 0; i < size; i++) {
+    getRef(hashes, i) = seededHash<Hash>(buf[i].first, seed);
   }
+  return hashes;
+}
+
+// the builder searches hash seeds at this fixed load factor of about
+// 0.9, the table size never has to grow
+constexpr size_t getTableSize(size_t size) { return size + size / 8 + 1; }
 
-  return dstArr;
+// only the key count matters now, the array stays for the callers
+template <typename Hash, typename T, size_t size>
+constexpr size_t getPerfectHashSize(const std::array<T, size>&) {
+  return getTableSize(size);
 }
 
+// the seed search behind getDisplacements, buf holds keys or pairs
+template <typename Hash, typename Key, size_t mapSize, typename T,
+          size_t size>
+constexpr std::array<uint16_t, getBucketCount(size)> searchDisplacements(
+    const std::array<T, size>& buf, uint32_t& seedOut) {
+  constexpr size_t bucketCount = getBucketCount(size);
+  constexpr uint32_t seedCount = getSeedCount<Hash, Key>();
+
+  std::array<uint16_t, bucketCount> displacements{};
+  DisplacementWorkspace<size, bucketCount, mapSize> ws{};
+  for (uint32_t seed = 0; seed < seedCount; seed++) {
+    auto hashes = getHashes<Hash>(buf, seed);
+    if (buildDisplacements(hashes, size, displacements, bucketCount, mapSize,
+                           ws)) {
+      seedOut = seed;
+      return displacements;
+    }
+  }
+  // only reachable in a constant expression, so this fails the build
+  throw std::logic_error("no hash seed gives a perfect hash for these keys");
+}
+
+// hash all entries once per seed until the displacement builder can
+// place them, and report the seed through seedOut. running out of seeds
+// fails the build. hashes are 32 bits, so past ~150k keys most seeds
+// give some duplicate and the search starts to fail
+template <typename Hash, size_t mapSize, typename First, typename Second,
+          size_t size>
+constexpr std::array<uint16_t, getBucketCount(size)> getDisplacements(
+    const std::array<std::pair<First, Second>, size>& buf, uint32_t& seedOut) {
+  return searchDisplacements<Hash, First, mapSize>(buf, seedOut);
+}
+
+// the same over the keys alone, for tables that keep the values elsewhere
+template <typename Hash, size_t mapSize, typename Key, size_t size>
+constexpr std::array<uint16_t, getBucketCount(size)> getDisplacements(
+    const std::array<Key, size>& keys, uint32_t& seedOut) {
+  return searchDisplacements<Hash, Key, mapSize>(keys, seedOut);
+}
+
+// buildDisplacements scratch space sized at runtime
+struct RuntimeDisplacementWorkspace {
+  RuntimeDisplacementWorkspace(size_t size, size_t bucketCount,
+                               size_t mapSize)
+      : bucketStart(bucketCount + 1),
+        keyOrder(size),
+        bucketOrder(bucketCount),
+        sizeStart(size + 1),
+        taken(mapSize) {}
+
+  std::vector<size_t> bucketStart;
+  std::vector<size_t> keyOrder;
+  std::vector<size_t> bucketOrder;
+  std::vector<size_t> sizeStart;
+  std::vector<unsigned char> taken;
+};
+
+// getDisplacements for keys only known at runtime. the seeds are tried in
+// the same order, so the same keys in the same order give the same seed
+// and displacements as the constexpr builder
+template <typename Hash, typename Key>
+std::vector<uint16_t> getDisplacements(const std::vector<Key>& keys,
+                                       size_t mapSize, uint32_t& seedOut) {
+  size_t bucketCount = getBucketCount(keys.size());
+  constexpr uint32_t seedCount = getSeedCount<Hash, Key>();
+
+  std::vector<uint16_t> displacements(bucketCount);
+  std::vector<uint32_t> hashes(keys.size());
+  RuntimeDisplacementWorkspace ws(keys.size(), bucketCount, mapSize);
+  for (uint32_t seed = 0; seed < seedCount; seed++) {
+    for (size_t i = 0; i < keys.size(); i++) {
+      hashes[i] = seededHash<Hash>(keys[i], seed);
+    }
+    if (buildDisplacements(hashes, keys.size(), displacements, bucketCount,
+                           mapSize, ws)) {
+      seedOut = seed;
+      return displacements;
+    }
+  }
+  throw std::logic_error("no hash seed gives a perfect hash for these keys");
+}
+
+// stands in for the tag array of untagged maps
+struct NoTags {};
+
+// slot layouts for HashMap. a layout provides Storage<Key, Value, size>
+// with set, key, value, keyAddress and fromSlots
+
+// array of structs, every slot keeps its key and value side by side
+struct AosLayout {
+  template <typename Key, typename Value, size_t size>
+  struct Storage {
+    constexpr void set(size_t idx, const Key& key, const Value& value) {
+      getRef(slots, idx).first = key;
+      getRef(slots, idx).second = value;
+    }
+
+    constexpr const Key& key(size_t idx) const { return slots.at(idx).first; }
+
+    constexpr const Value& value(size_t idx) const {
+      return slots[idx].second;
+    }
+
+    constexpr const void* keyAddress(size_t idx) const { return &slots[idx]; }
+
+    static constexpr Storage fromSlots(const std::array<Key, size>& keys,
+                                       const std::array<Value, size>& values) {
+      Storage storage{};
+      for (size_t i = 0; i < size; i++) {
+        storage.set(i, keys[i], values[i]);
+      }
+      return storage;
+    }
+
+    std::array<std::pair<Key, Value>, size> slots;
+  };
+};
+
+// struct of arrays, the probe only touches the compact key array and the
+// value array is read on a hit. pays off once values outgrow the keys
+struct SoaLayout {
+  template <typename Key, typename Value, size_t size>
+  struct Storage {
+    constexpr void set(size_t idx, const Key& key, const Value& value) {
+      getRef(keys, idx) = key;
+      getRef(values, idx) = value;
+    }
+
+    constexpr const Key& key(size_t idx) const { return keys.at(idx); }
+
+    constexpr const Value& value(size_t idx) const { return values[idx]; }
+
+    constexpr const void* keyAddress(size_t idx) const { return &keys[idx]; }
+
+    // copied whole, which compilers evaluate much faster than slot by slot
+    static constexpr Storage fromSlots(const std::array<Key, size>& keys,
+                                       const std::array<Value, size>& values) {
+      return Storage{keys, values};
+    }
+
+    std::array<Key, size> keys;
+    std::array<Value, size> values;
+  };
+};
+
+// places every pair at its slot of storage. when tags is an array, the
+// full key hash is stored next to the slot index as well, so lookups can
+// reject a miss without running the comparator
+template <typename HashFunc, typename Storage, size_t dst, size_t src,
+          typename Key, typename Value, size_t bucketCount, typename Tags>
+constexpr Storage placeSlots(
+    const std::array<std::pair<Key, Value>, src>& srcArr, uint32_t seed,
+    const std::array<uint16_t, bucketCount>& displacements, Tags& tags) {
+  Storage storage{};
+  for (size_t i = 0; i < src; i++) {
+    uint32_t hashVal = seededHash<HashFunc>(srcArr[i].first, seed);
+    size_t slot = getSlot(
+        hashVal, displacements[getBucket(hashVal, bucketCount)], dst);
+    storage.set(slot, srcArr[i].first, srcArr[i].second);
+    if constexpr (!std::is_same_v<Tags, NoTags>) {
+      static_assert(std::tuple_size<Tags>::value == dst, "one tag per slot");
+      getRef(tags, slot) = hashVal;
+    }
+  }
+  return storage;
+}
+
+// what HashMap::stats reports about a built table, meant for static_assert
+// budgets on generated tables
+struct HashMapStats {
+  size_t keys = 0;
+  size_t slots = 0;
+  // keys / slots
+  double load_factor = 0;
+  // the footprint of the map
+  size_t bytes = 0;
+  // the table size is fixed up front, only seeds are retried
+  uint32_t size_attempts = 0;
+  uint32_t seed_attempts = 0;
+  // the largest displacement any bucket needed, the search tries them in
+  // order so this is also the longest search
+  uint32_t max_displacement = 0;
+  // Hash::name, "unnamed" for hashers without one
+  const char* hash = nullptr;
+  // comparator calls per lookup, a tagged map skips it on most misses
+  size_t max_comparisons = 0;
+  // longest key in chars when keys are strings, which bounds the work of
+  // a single comparison. 0 for other keys
+  size_t max_key_length = 0;
+};
+
+// with tagged set, every slot also keeps the hash of its key, and get
+// only calls the comparator when the hashes match. Instrument counts the
+// runtime lookups, see instrumentation.h. Layout picks how the slots are
+// stored, AosLayout or SoaLayout
 template <size_t bufSize, size_t mapSize, typename Key, typename Value,
-          typename Comparator, typename hash>
+          typename Comparator, typename hash, bool tagged = false,
+          typename Instrument = NoInstrumentation,
+          typename Layout = AosLayout>
 class HashMap {
+  using Storage = typename Layout::template Storage<Key, Value, mapSize>;
+
  public:
+  static constexpr size_t bucketCount = getBucketCount(bufSize);
+  static_assert(mapSize >= bufSize, "table must have a slot for every key");
+
+  // one tag per slot, none unless tagged
+  static constexpr size_t tagCount = tagged ? mapSize : 0;
+
+  // bytes taken by the seed, the displacements, the tags and the slots
+  static constexpr size_t footprint =
+      sizeof(uint32_t) + sizeof(std::array<uint16_t, bucketCount>) +
+      sizeof(uint32_t) * tagCount + sizeof(Storage);
+
+  using Tags = std::conditional_t<tagged, std::array<uint32_t, mapSize>,
+                                  NoTags>;
+
   constexpr HashMap(const std::array<std::pair<Key, Value>, bufSize>& arr)
-      : buf_(transformWithHash<hash, mapSize>(arr)) {}
+      : seed_{},
+        displacements_(getDisplacements<hash, mapSize>(arr, seed_)),
+        tags_{},
+        buf_(placeSlots<hash, Storage, mapSize>(arr, seed_, displacements_,
+                                                tags_)) {}
+
+  // a table built ahead of time, as generate_hashmap.cpp emits it. keys
+  // and values are in slot order with value initialized empty slots, and
+  // tags holds the key hashes of a tagged map. nothing is hashed, so this
+  // stays cheap to compile for any number of keys
+  constexpr HashMap(uint32_t seed,
+                    const std::array<uint16_t, bucketCount>& displacements,
+                    const std::array<Key, mapSize>& keys,
+                    const std::array<Value, mapSize>& values,
+                    const Tags& tags = {})
+      : seed_(seed),
+        displacements_(displacements),
+        tags_(tags),
+        buf_(Storage::fromSlots(keys, values)) {}
 
   constexpr Value get(const Key& key) const {
-    hash hasher;
+    if constexpr (Instrument::enabled) {
+      if (!is_constant_evaluated()) {
+        return instrumentedGet(key);
+      }
+    }
+    uint32_t hashVal = seededHash<hash>(key, seed_);
+    return getAt(key, hashVal, slotOf(hashVal));
+  }
+
+  // lookup by a slice that need not be NUL terminated, such as a view into
+  // a receive buffer, without copying it. the hasher has to take a
+  // std::string_view, and the comparator is used when it takes one as
+  // well, otherwise the slice is compared byte by byte
+  template <typename K = Key,
+            typename = std::enable_if_t<std::is_same_v<K, const char*>>>
+  constexpr Value get(std::string_view key) const {
+    static_assert(std::is_invocable_v<hash&, std::string_view, uint32_t> ||
+                      std::is_invocable_v<hash&, std::string_view>,
+                  "the hasher has to take std::string_view");
+    if constexpr (Instrument::enabled) {
+      if (!is_constant_evaluated()) {
+        return instrumentedGet(key);
+      }
+    }
+    uint32_t hashVal = seededHash<hash>(key, seed_);
+    return getAt(key, hashVal, slotOf(hashVal));
+  }
+
+  template <typename K = Key,
+            typename = std::enable_if_t<std::is_same_v<K, const char*>>>
+  constexpr Value get(const char* key, size_t len) const {
+    return get(std::string_view(key, len));
+  }
+
+  // looks up a batch of keys in three passes: hash every key, then find
+  // and prefetch every slot, then compare. the cache misses of the whole
+  // batch overlap instead of following one another
+  constexpr void get_many(const Key* keys, Value* values, size_t count) const {
+    constexpr size_t batch = 16;
+    std::array<uint32_t, batch> hashes{};
+    std::array<size_t, batch> slots{};
+    for (size_t begin = 0; begin < count; begin += batch) {
+      size_t len = count - begin < batch ? count - begin : batch;
+      for (size_t i = 0; i < len; i++) {
+        hashes[i] = seededHash<hash>(keys[begin + i], seed_);
+      }
+      for (size_t i = 0; i < len; i++) {
+        slots[i] = slotOf(hashes[i]);
+        if constexpr (tagged) {
+          prefetch(&tags_[slots[i]]);
+        }
+        prefetch(buf_.keyAddress(slots[i]));
+      }
+      for (size_t i = 0; i < len; i++) {
+        if constexpr (Instrument::enabled) {
+          if (!is_constant_evaluated()) {
+            values[begin + i] =
+                countedGetAt(keys[begin + i], hashes[i], slots[i]);
+            continue;
+          }
+        }
+        values[begin + i] = getAt(keys[begin + i], hashes[i], slots[i]);
+      }
+    }
+  }
+
+#if defined(__cpp_lib_span)
+  // values needs room for an answer per key
+  void get_many(std::span<const Key> keys, std::span<Value> values) const {
+    assert(values.size() >= keys.size());
+    get_many(keys.data(), values.data(), keys.size());
+  }
+#endif
+
+  // the hash seed the builder settled on
+  constexpr uint32_t seed() const { return seed_; }
+
+  // computed from the table on every call, cheap enough in a
+  // static_assert but not meant for hot paths
+  constexpr HashMapStats stats() const {
+    HashMapStats res{};
+    res.keys = bufSize;
+    res.slots = mapSize;
+    res.load_factor = static_cast<double>(bufSize) / mapSize;
+    res.bytes = footprint;
+    res.size_attempts = 1;
+    // seeds are tried from 0 up
+    res.seed_attempts = seed_ + 1;
+    for (size_t i = 0; i < bucketCount; i++) {
+      if (displacements_[i] > res.max_displacement) {
+        res.max_displacement = displacements_[i];
+      }
+    }
+    res.hash = HashName<hash>::value;
+    res.max_comparisons = 1;
+    if constexpr (std::is_convertible_v<const Key&, std::string_view>) {
+      for (size_t i = 0; i < mapSize; i++) {
+        if constexpr (std::is_pointer_v<Key>) {
+          // empty slots hold a null key
+          if (buf_.key(i) == nullptr) {
+            continue;
+          }
+        }
+        size_t len = std::string_view(buf_.key(i)).size();
+        if (len > res.max_key_length) {
+          res.max_key_length = len;
+        }
+      }
+    }
+    return res;
+  }
+
+  void print() const {
+    std::cout << "show buf size " << mapSize;
+    for (size_t idx = 0; idx < mapSize; idx++) {
+      if (buf_.key(idx)) {
+        std::cout << "key " << buf_.key(idx) << " idx " << idx << std::endl;
+      }
+    }
+  }
+
+ private:
+  constexpr size_t slotOf(uint32_t hashVal) const {
+    return getSlot(hashVal, displacements_[getBucket(hashVal, bucketCount)],
+                   mapSize);
+  }
+
+  // Lookup is Key, or a std::string_view for const char* keys
+  template <typename Lookup>
+  static constexpr bool keyEquals(const Lookup& key, const Key& stored) {
     Comparator compare;
-    size_t idx = hasher(key) % mapSize;
-    if (compare(key, buf_.at(idx).first) == 0) {
-      return buf_[idx].second;
+    if constexpr (std::is_same_v<Lookup, Key> ||
+                  std::is_invocable_v<Comparator&, const Lookup&,
+                                      const Key&>) {
+      return compare(key, stored) == 0;
+    } else {
+      // empty slots hold a null key
+      if (stored == nullptr) {
+        return false;
+      }
+      for (size_t i = 0; i < key.size(); i++) {
+        if (stored[i] == '\0' || stored[i] != key[i]) {
+          return false;
+        }
+      }
+      return stored[key.size()] == '\0';
+    }
+  }
+
+  template <typename Lookup>
+  constexpr Value getAt(const Lookup& key, uint32_t hashVal,
+                        size_t idx) const {
+    if constexpr (tagged) {
+      if (tags_[idx] != hashVal) {
+        return Value();
+      }
+    }
+    if (keyEquals(key, buf_.key(idx))) {
+      return buf_.value(idx);
     } else {
       return Value();
     }
   }
 
-  void print() const {
-    std::cout << "show buf size " << buf_.size();
-    for (auto it = buf_.begin(); it != buf_.end(); it++) {
-      if (it->first) {
-        std::cout << "key " << it->first << " idx "
-                  << std::distance(buf_.begin(), it) << std::endl;
+  // getAt, also telling the policy about the lookup
+  template <typename Lookup>
+  Value countedGetAt(const Lookup& key, uint32_t hashVal, size_t idx) const {
+    bool compared = true;
+    if constexpr (tagged) {
+      compared = tags_[idx] == hashVal;
+    }
+    bool hit = compared && keyEquals(key, buf_.key(idx));
+    Instrument::local().record(hit, compared);
+    return hit ? buf_.value(idx) : Value();
+  }
+
+  template <typename Lookup>
+  Value instrumentedGet(const Lookup& key) const {
+    auto& counters = Instrument::local();
+    if (!counters.sample()) {
+      uint32_t hashVal = seededHash<hash>(key, seed_);
+      return countedGetAt(key, hashVal, slotOf(hashVal));
+    }
+    uint64_t start = readCycles();
+    uint32_t hashVal = seededHash<hash>(key, seed_);
+    Value res = countedGetAt(key, hashVal, slotOf(hashVal));
+    counters.recordCycles(readCycles() - start);
+    return res;
+  }
+
+  uint32_t seed_;
+  std::array<uint16_t, bucketCount> displacements_;
+  CEXPR_NO_UNIQUE_ADDRESS Tags tags_;
+  Storage buf_;
+};
+
+// minimal perfect hash, one slot per key. takes longer to build than the
+// default load factor of getPerfectHashSize
+template <size_t bufSize, typename Key, typename Value, typename Comparator,
+          typename hash, bool tagged = false,
+          typename Instrument = NoInstrumentation,
+          typename Layout = AosLayout>
+using MinimalHashMap = HashMap<bufSize, bufSize, Key, Value, Comparator, hash,
+                               tagged, Instrument, Layout>;
+
+// chars needed to pool every key of arr, see PooledHashMap
+template <typename T, size_t size>
+constexpr size_t getKeyPoolSize(const std::array<T, size>& arr) {
+  size_t total = 0;
+  for (size_t i = 0; i < size; i++) {
+    total += length(arr[i].first);
+  }
+  return total;
+}
+
+template <typename Value>
+struct PooledSlot {
+  // where the key starts in the pool, and its length. empty slots have
+  // length 0, so an empty key that lands on one still misses correctly
+  uint32_t offset = 0;
+  uint32_t length = 0;
+  Value value{};
+};
+
+// HashMap with the keys packed into one char pool owned by the map, in
+// slot order, instead of pointers into string literals. a lookup compares
+// the length stored in the slot first and then reads the key bytes from
+// the pool, which sits right behind the slots, instead of chasing a
+// pointer to an unrelated line. the table holds no key pointers, so a
+// PIE binary needs no relocations for it. keys are compared byte by byte,
+// the hasher has to take std::string_view
+template <size_t bufSize, size_t mapSize, size_t poolSize, typename Value,
+          typename hash>
+class PooledHashMap {
+ public:
+  static constexpr size_t bucketCount = getBucketCount(bufSize);
+  static_assert(mapSize >= bufSize, "table must have a slot for every key");
+  static_assert(std::is_invocable_v<hash&, std::string_view, uint32_t> ||
+                    std::is_invocable_v<hash&, std::string_view>,
+                "the hasher has to take std::string_view");
+
+  // bytes taken by the seed, the displacements, the slots and the pool
+  static constexpr size_t footprint =
+      sizeof(uint32_t) + sizeof(std::array<uint16_t, bucketCount>) +
+      sizeof(std::array<PooledSlot<Value>, mapSize>) +
+      sizeof(std::array<char, poolSize>);
+
+  constexpr PooledHashMap(
+      const std::array<std::pair<const char*, Value>, bufSize>& arr)
+      : seed_{},
+        displacements_(getDisplacements<hash, mapSize>(views(arr), seed_)),
+        slots_{},
+        pool_{} {
+    // the source key of every slot, then copy the keys over in slot order
+    std::array<size_t, mapSize> keyOf{};
+    std::array<bool, mapSize> used{};
+    for (size_t i = 0; i < bufSize; i++) {
+      size_t slot = slotOf(seededHash<hash>(
+          std::string_view(arr[i].first, length(arr[i].first)), seed_));
+      keyOf[slot] = i;
+      used[slot] = true;
+    }
+    size_t offset = 0;
+    for (size_t slot = 0; slot < mapSize; slot++) {
+      if (!used[slot]) {
+        continue;
+      }
+      const char* key = arr[keyOf[slot]].first;
+      size_t len = length(key);
+      if (offset + len > poolSize) {
+        throw std::logic_error("poolSize is smaller than getKeyPoolSize");
+      }
+      slots_[slot].offset = static_cast<uint32_t>(offset);
+      slots_[slot].length = static_cast<uint32_t>(len);
+      slots_[slot].value = arr[keyOf[slot]].second;
+      for (size_t i = 0; i < len; i++) {
+        pool_[offset++] = key[i];
       }
     }
+    if (offset != poolSize) {
+      throw std::logic_error("poolSize is larger than getKeyPoolSize");
+    }
+  }
+
+  constexpr Value get(std::string_view key) const {
+    uint32_t hashVal = seededHash<hash>(key, seed_);
+    const PooledSlot<Value>& slot = slots_[slotOf(hashVal)];
+    if (slot.length != key.size() ||
+        (key.size() != 0 &&
+         !equalChars(&pool_[slot.offset], key.data(), key.size()))) {
+      return Value();
+    }
+    return slot.value;
+  }
+
+  constexpr Value get(const char* key) const {
+    return get(std::string_view(key, length(key)));
   }
 
+  constexpr Value get(const char* key, size_t len) const {
+    return get(std::string_view(key, len));
+  }
+
+  // the hash seed the builder settled on
+  constexpr uint32_t seed() const { return seed_; }
+
  private:
-  std::array<std::pair<Key, Value>, mapSize> buf_;
+  // the builder only needs the keys, hashed as slices like get does
+  static constexpr std::array<std::string_view, bufSize> views(
+      const std::array<std::pair<const char*, Value>, bufSize>& arr) {
+    std::array<std::string_view, bufSize> res{};
+    for (size_t i = 0; i < bufSize; i++) {
+      getRef(res, i) = std::string_view(arr[i].first, length(arr[i].first));
+    }
+    return res;
+  }
+
+  constexpr size_t slotOf(uint32_t hashVal) const {
+    return getSlot(hashVal, displacements_[getBucket(hashVal, bucketCount)],
+                   mapSize);
+  }
+
+  uint32_t seed_;
+  std::array<uint16_t, bucketCount> displacements_;
+  std::array<PooledSlot<Value>, mapSize> slots_;
+  std::array<char, poolSize> pool_;
 };
 }
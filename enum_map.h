@@ -0,0 +1,164 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "./const_hashmap.h"
+
+namespace cexpr {
+
+// names of the values of an enum, both ways, from one array:
+//   constexpr std::array<std::pair<Method, const char*>, 3> methods{
+//       {{Method::kGet, "GET"}, {Method::kPut, "PUT"}, {Method::kPost, "POST"}}};
+//   constexpr cexpr::EnumMap<Method, 3> methodNames(methods);
+//   methodNames.name(Method::kPut) == "PUT"
+//   methodNames.parse("POST") == Method::kPost
+// parse is a perfect hash of the name, a length check and one compare, and
+// name indexes a dense array by the value less the smallest one. enums
+// with gaps between their values take the span of the values as well,
+// from getEnumSpan. a value with several names is printed by the first
+
+// largest value less smallest value plus one, see EnumMap
+template <typename Enum, size_t size>
+constexpr size_t getEnumSpan(
+    const std::array<std::pair<Enum, const char*>, size>& arr) {
+  using Underlying = std::underlying_type_t<Enum>;
+  Underlying min = static_cast<Underlying>(arr[0].first);
+  Underlying max = min;
+  for (size_t i = 1; i < size; i++) {
+    Underlying value = static_cast<Underlying>(arr[i].first);
+    min = value < min ? value : min;
+    max = value > max ? value : max;
+  }
+  return static_cast<size_t>(static_cast<uint64_t>(max) -
+                             static_cast<uint64_t>(min)) +
+         1;
+}
+
+template <typename Enum, size_t size, size_t span = size,
+          typename hash = fnv1aHasher>
+class EnumMap {
+  using Underlying = std::underlying_type_t<Enum>;
+
+ public:
+  static constexpr size_t mapSize = getTableSize(size);
+  static constexpr size_t bucketCount = getBucketCount(size);
+  static_assert(size > 0, "an enum map needs a name");
+  static_assert(std::is_invocable_v<hash&, std::string_view, uint32_t> ||
+                    std::is_invocable_v<hash&, std::string_view>,
+                "the hasher has to take std::string_view");
+
+  // empty slots hold no value, so an empty name that lands on one still
+  // misses
+  struct Slot {
+    std::string_view name;
+    std::optional<Enum> value;
+  };
+
+  // bytes taken by the seed, the displacements, the slots and the names
+  static constexpr size_t footprint =
+      sizeof(uint32_t) + sizeof(std::array<uint16_t, bucketCount>) +
+      sizeof(std::array<Slot, mapSize>) +
+      sizeof(std::array<std::string_view, span + 1>);
+
+  // throws std::logic_error when span is smaller than getEnumSpan, and
+  // when no seed gives a perfect hash, as with duplicate names
+  constexpr EnumMap(const std::array<std::pair<Enum, const char*>, size>& arr)
+      : min_(minValue(arr)),
+        seed_{},
+        displacements_(getDisplacements<hash, mapSize>(views(arr), seed_)),
+        slots_{},
+        names_{} {
+    for (size_t i = 0; i < size; i++) {
+      std::string_view name(arr[i].second, length(arr[i].second));
+      Slot& slot = getRef(slots_, slotOf(seededHash<hash>(name, seed_)));
+      slot.name = name;
+      slot.value = arr[i].first;
+    }
+    // gcc does not let a constant expression read an entry the
+    // initializer list left alone, so every entry is written
+    for (size_t i = 0; i <= span; i++) {
+      getRef(names_, i) = std::string_view();
+    }
+    for (size_t i = size; i-- > 0;) {
+      size_t idx = indexOf(arr[i].first);
+      if (idx >= span) {
+        throw std::logic_error("span is smaller than getEnumSpan");
+      }
+      // backwards, so the first name of a value is the one kept
+      getRef(names_, idx) = std::string_view(arr[i].second,
+                                             length(arr[i].second));
+    }
+  }
+
+  // the name of value, empty for a value the array did not name. values
+  // past the span read the empty entry behind it
+  constexpr std::string_view name(Enum value) const {
+    size_t idx = indexOf(value);
+    return names_[idx < span ? idx : span];
+  }
+
+  constexpr std::optional<Enum> parse(std::string_view name) const {
+    const Slot& slot = slots_[slotOf(seededHash<hash>(name, seed_))];
+    bool equal = slot.name.size() == name.size() &&
+                 equalChars(slot.name.data(), name.data(), name.size());
+    return equal ? slot.value : std::nullopt;
+  }
+
+  constexpr std::optional<Enum> parse(const char* name, size_t len) const {
+    return parse(std::string_view(name, len));
+  }
+
+  // parse, or fallback for an unknown name
+  constexpr Enum parse(std::string_view name, Enum fallback) const {
+    return parse(name).value_or(fallback);
+  }
+
+  // the hash seed the builder settled on
+  constexpr uint32_t seed() const { return seed_; }
+
+ private:
+  static constexpr Underlying minValue(
+      const std::array<std::pair<Enum, const char*>, size>& arr) {
+    Underlying min = static_cast<Underlying>(arr[0].first);
+    for (size_t i = 1; i < size; i++) {
+      Underlying value = static_cast<Underlying>(arr[i].first);
+      min = value < min ? value : min;
+    }
+    return min;
+  }
+
+  // the builder only needs the names, hashed as slices like parse does
+  static constexpr std::array<std::string_view, size> views(
+      const std::array<std::pair<Enum, const char*>, size>& arr) {
+    std::array<std::string_view, size> res{};
+    for (size_t i = 0; i < size; i++) {
+      getRef(res, i) = std::string_view(arr[i].second, length(arr[i].second));
+    }
+    return res;
+  }
+
+  // wraps around below the smallest value, so those land past the span
+  // as well
+  constexpr size_t indexOf(Enum value) const {
+    return static_cast<size_t>(
+        static_cast<uint64_t>(static_cast<Underlying>(value)) -
+        static_cast<uint64_t>(min_));
+  }
+
+  constexpr size_t slotOf(uint32_t hashVal) const {
+    return getSlot(hashVal, displacements_[getBucket(hashVal, bucketCount)],
+                   mapSize);
+  }
+
+  Underlying min_;
+  uint32_t seed_;
+  std::array<uint16_t, bucketCount> displacements_;
+  std::array<Slot, mapSize> slots_;
+  // one more than the span, the entry behind it stays empty
+  std::array<std::string_view, span + 1> names_;
+};
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+#include "./algorithm.h"
+#include "./thread_pool.h"
+
+namespace cexpr {
+
+// execution policies for the runtime overloads below, mirroring
+// std::execution. the constexpr overloads in algorithm.h are untouched,
+// these are for large inputs at runtime only
+namespace execution {
+
+struct sequenced_policy {};
+struct parallel_policy {};
+// the kernels a part runs are vectorized where algorithm.h can, so this
+// splits the work exactly like parallel_policy
+struct parallel_unsequenced_policy {};
+
+inline constexpr sequenced_policy seq{};
+inline constexpr parallel_policy par{};
+inline constexpr parallel_unsequenced_policy par_unseq{};
+}
+
+template <typename T>
+constexpr bool is_execution_policy_v =
+    std::is_same<std::decay_t<T>, execution::sequenced_policy>::value ||
+    std::is_same<std::decay_t<T>, execution::parallel_policy>::value ||
+    std::is_same<std::decay_t<T>, execution::parallel_unsequenced_policy>::
+        value;
+
+// elements below which a part is not worth a task
+constexpr size_t parallelGrain = 1 << 14;
+
+// parts of at least parallelGrain elements, a few per thread so that
+// stealing can even out slow parts, and only one for sequenced execution
+template <typename ExecutionPolicy>
+size_t getPartCount(size_t len) {
+  if (std::is_same<std::decay_t<ExecutionPolicy>,
+                   execution::sequenced_policy>::value) {
+    return 1;
+  }
+  size_t parts = (len + parallelGrain - 1) / parallelGrain;
+  return std::max<size_t>(
+      std::min(parts, 4 * (ThreadPool::global().size() + 1)), 1);
+}
+
+// fn(begin, end) gets called once per part of [0, len)
+template <typename ExecutionPolicy, typename Fn>
+void forEachPart(ExecutionPolicy&&, size_t len, const Fn& fn) {
+  size_t parts = getPartCount<ExecutionPolicy>(len);
+  if (parts == 1) {
+    fn(size_t(0), len);
+    return;
+  }
+  ThreadPool::global().parallelFor(parts, [&fn, len, parts](size_t part) {
+    fn(len * part / parts, len * (part + 1) / parts);
+  });
+}
+
+template <typename ExecutionPolicy, typename RandomIt>
+using EnableIfPolicy =
+    std::enable_if_t<is_execution_policy_v<ExecutionPolicy> &&
+                     std::is_base_of<std::random_access_iterator_tag,
+                                     typename std::iterator_traits<
+                                         RandomIt>::iterator_category>::value>;
+
+template <
+    size_t N, typename ExecutionPolicy, typename UnaryOp, typename RandomIt,
+    typename T = typename std::iterator_traits<RandomIt>::value_type,
+    typename = EnableIfPolicy<ExecutionPolicy, RandomIt>>
+std::array<typename std::result_of<UnaryOp(const T&)>::type, N> for_each_n(
+    ExecutionPolicy&& policy, RandomIt begin, RandomIt end, UnaryOp unaryOp) {
+  std::array<typename std::result_of<UnaryOp(const T&)>::type, N> output{};
+  size_t len = std::min(static_cast<size_t>(end - begin), N);
+  forEachPart(policy, len, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      output[i] = unaryOp(begin[i]);
+    }
+  });
+  return output;
+}
+
+template <typename ExecutionPolicy, typename T, size_t size, typename UnaryOp,
+          typename Out = typename std::result_of<UnaryOp(const T&)>::type,
+          typename = std::enable_if_t<is_execution_policy_v<ExecutionPolicy>>>
+std::array<Out, size> for_each_array(ExecutionPolicy&& policy,
+                                     const std::array<T, size>& cinput,
+                                     UnaryOp unaryOp) {
+  return for_each_n<size>(policy, cinput.begin(), cinput.end(), unaryOp);
+}
+
+template <typename ExecutionPolicy, typename RandomIt, typename T,
+          typename = EnableIfPolicy<ExecutionPolicy, RandomIt>>
+size_t count(ExecutionPolicy&& policy, RandomIt begin, RandomIt end,
+             const T& val) {
+  std::atomic<size_t> total{0};
+  forEachPart(policy, static_cast<size_t>(end - begin),
+              [&](size_t first, size_t last) {
+                total.fetch_add(cexpr::count(begin + first, begin + last, val),
+                                std::memory_order_relaxed);
+              });
+  return total.load();
+}
+
+// every part records the earliest match it sees. a part only looks at
+// blocks that start before the best match so far, so once a match is
+// found the parts after it stop at their next block and the ones not
+// started yet return right away
+template <typename ExecutionPolicy, typename RandomIt, typename UnaryPredicate,
+          typename = EnableIfPolicy<ExecutionPolicy, RandomIt>>
+RandomIt find_if(ExecutionPolicy&& policy, RandomIt begin, RandomIt end,
+                 UnaryPredicate predicate) {
+  constexpr size_t block = 4096;
+  size_t len = static_cast<size_t>(end - begin);
+  std::atomic<size_t> best{len};
+  forEachPart(policy, len, [&](size_t first, size_t last) {
+    for (; first < last; first += block) {
+      if (best.load(std::memory_order_relaxed) < first) {
+        return;
+      }
+      size_t stop = std::min(first + block, last);
+      RandomIt hit =
+          cexpr::find_if(begin + first, begin + stop, predicate);
+      if (hit != begin + stop) {
+        size_t idx = static_cast<size_t>(hit - begin);
+        size_t cur = best.load(std::memory_order_relaxed);
+        while (idx < cur && !best.compare_exchange_weak(
+                                cur, idx, std::memory_order_relaxed)) {
+        }
+        return;
+      }
+    }
+  });
+  return begin + best.load();
+}
+
+// every part reduces its own range starting from its first element, then
+// the partial results are combined pairwise, neighbours first. the
+// grouping only depends on the part count, so floating point results are
+// the same from run to run on one machine
+template <typename ExecutionPolicy, typename RandomIt, typename T,
+          typename BinaryOp,
+          typename = EnableIfPolicy<ExecutionPolicy, RandomIt>>
+T reduce(ExecutionPolicy&&, RandomIt first, RandomIt last, T init,
+         BinaryOp op) {
+  size_t len = static_cast<size_t>(last - first);
+  size_t parts = getPartCount<ExecutionPolicy>(len);
+  if (parts == 1) {
+    return cexpr::reduce(first, last, init, op);
+  }
+  std::vector<T> partials(parts, init);
+  ThreadPool::global().parallelFor(parts, [&](size_t part) {
+    RandomIt begin = first + len * part / parts;
+    RandomIt end = first + len * (part + 1) / parts;
+    partials[part] = cexpr::reduce(begin + 1, end, T(*begin), op);
+  });
+  for (size_t width = 1; width < parts; width *= 2) {
+    for (size_t i = 0; i + width < parts; i += 2 * width) {
+      partials[i] = op(partials[i], partials[i + width]);
+    }
+  }
+  return op(init, partials[0]);
+}
+
+template <typename ExecutionPolicy, typename RandomIt, typename T,
+          typename = EnableIfPolicy<ExecutionPolicy, RandomIt>>
+T reduce(ExecutionPolicy&& policy, RandomIt first, RandomIt last, T init) {
+  return cexpr::reduce(policy, first, last, init, Plus<T>());
+}
+
+template <typename ExecutionPolicy, typename RandomIt,
+          typename = EnableIfPolicy<ExecutionPolicy, RandomIt>>
+typename std::iterator_traits<RandomIt>::value_type reduce(
+    ExecutionPolicy&& policy, RandomIt first, RandomIt last) {
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  return cexpr::reduce(policy, first, last, T{}, Plus<T>());
+}
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include "./algorithm.h"
+#include "./base.h"
+
+namespace cexpr {
+
+// sorted map built at compile time. unlike HashMap it cannot fail to
+// build, and it answers ordered and range queries through ranks, the
+// position of an entry in key order.
+//
+// the search runs over a copy of the keys in eytzinger (bfs) order: node
+// k has its children at 2k and 2k + 1, so the first levels share cache
+// lines, every step is a branchless index update, and the nodes a few
+// levels down can be prefetched. keys and values are also kept in key
+// order for the rank based accessors
+template <size_t bufSize, typename Key, typename Value,
+          typename Compare = Less<Key>>
+class FlatMap {
+ public:
+  constexpr FlatMap(const std::array<std::pair<Key, Value>, bufSize>& arr)
+      : keys_{}, values_{}, eytKeys_{}, eytRanks_{} {
+    Compare comp;
+    std::array<size_t, bufSize> order{};
+    std::array<size_t, bufSize> scratch{};
+    for (size_t i = 0; i < bufSize; i++) {
+      order[i] = i;
+    }
+    cexpr::stable_sort(order.begin(), order.end(), scratch.begin(),
+                       [&arr, &comp](size_t lhs, size_t rhs) {
+                         return comp(arr[lhs].first, arr[rhs].first);
+                       });
+    for (size_t i = 0; i < bufSize; i++) {
+      keys_[i] = arr[order[i]].first;
+      values_[i] = arr[order[i]].second;
+    }
+
+    // an in order walk of the implicit tree visits the nodes in key order
+    size_t node = 1;
+    while (node * 2 <= bufSize) {
+      node *= 2;
+    }
+    for (size_t rank = 0; rank < bufSize; rank++) {
+      eytKeys_[node] = keys_[rank];
+      eytRanks_[node] = rank;
+      if (node * 2 + 1 <= bufSize) {
+        node = node * 2 + 1;
+        while (node * 2 <= bufSize) {
+          node *= 2;
+        }
+      } else {
+        while (node & 1) {
+          node >>= 1;
+        }
+        node >>= 1;
+      }
+    }
+    eytRanks_[0] = bufSize;
+  }
+
+  // rank of the first key not less than key, size() when there is none
+  constexpr size_t lower_bound(const Key& key) const {
+    return eytRanks_[lowerNode(key)];
+  }
+
+  // rank of the first key greater than key, size() when there is none
+  constexpr size_t upper_bound(const Key& key) const {
+    Compare comp;
+    size_t node = 1;
+    while (node <= bufSize) {
+      prefetch(&eytKeys_[node * prefetchStride < eytKeys_.size()
+                             ? node * prefetchStride
+                             : 0]);
+      node = node * 2 + !comp(key, eytKeys_[node]);
+    }
+    return eytRanks_[node >> (countTrailingOnes(node) + 1)];
+  }
+
+  constexpr std::pair<size_t, size_t> equal_range(const Key& key) const {
+    return {lower_bound(key), upper_bound(key)};
+  }
+
+  // rank of key, size() when it is missing
+  constexpr size_t find(const Key& key) const {
+    Compare comp;
+    size_t node = lowerNode(key);
+    return node != 0 && !comp(key, eytKeys_[node]) ? eytRanks_[node]
+                                                   : bufSize;
+  }
+
+  constexpr Value get(const Key& key) const {
+    size_t rank = find(key);
+    return rank != bufSize ? values_[rank] : Value();
+  }
+
+  constexpr const Key& key(size_t rank) const { return keys_[rank]; }
+
+  constexpr const Value& value(size_t rank) const { return values_[rank]; }
+
+  constexpr size_t size() const { return bufSize; }
+
+ private:
+  // the descendants of node four levels down start at node * 16
+  static constexpr size_t prefetchStride = 16;
+
+  // eytzinger index of the first key not less than key, 0 when none is
+  constexpr size_t lowerNode(const Key& key) const {
+    Compare comp;
+    size_t node = 1;
+    while (node <= bufSize) {
+      prefetch(&eytKeys_[node * prefetchStride < eytKeys_.size()
+                             ? node * prefetchStride
+                             : 0]);
+      node = node * 2 + comp(eytKeys_[node], key);
+    }
+    // undo the right turns taken after the last left turn, that left turn
+    // happened at the answer
+    return node >> (countTrailingOnes(node) + 1);
+  }
+
+  // val always has a zero bit, the root index is far below size_t max
+  static constexpr int countTrailingOnes(size_t val) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(~static_cast<unsigned long long>(val));
+#else
+    int res = 0;
+    for (; val & 1; val >>= 1) {
+      res++;
+    }
+    return res;
+#endif
+  }
+
+  std::array<Key, bufSize> keys_;
+  std::array<Value, bufSize> values_;
+  // index 0 is unused, eytRanks_[0] maps "no answer" to size()
+  std::array<Key, bufSize + 1> eytKeys_;
+  std::array<size_t, bufSize + 1> eytRanks_;
+};
+}
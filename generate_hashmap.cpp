@@ -0,0 +1,317 @@
+// builds a HashMap ahead of time and writes it out as a header, for
+// tables too large to build in a constant expression in every TU:
+//   g++ -std=c++17 -O2 generate_hashmap.cpp -o generate_hashmap
+//   ./generate_hashmap [options] keys.txt > table.h
+// every line of the input holds a key, a tab and the value as a C++
+// expression, which is copied into the header as it is. the seed search
+// is the one the constexpr constructor runs, so the header holds the same
+// seed, displacements and slots a constexpr build of the keys in the same
+// order would, and a static_assert in it checks that the target hashes a
+// key as the generator did. options:
+//   --name NAME        variable name, table by default
+//   --namespace NS     namespace around it, none by default
+//   --value-type TYPE  uint32_t by default
+//   --comparator TYPE  cexpr::CStringComparator by default
+//   --hash HASH        fnv1, fnv1a or wordHash, fnv1 by default
+//   --tagged           keep per slot hash tags
+//   --soa              use SoaLayout
+//   --minimal          one slot per key, as MinimalHashMap
+//   --include HEADER   extra include for the value or comparator type
+//   --header PATH      how to include const_hashmap.h
+//   -o FILE            write to FILE instead of stdout
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "./const_hashmap.h"
+
+namespace {
+
+struct Options {
+  std::string name = "table";
+  std::string nameSpace;
+  std::string valueType = "uint32_t";
+  std::string comparator = "cexpr::CStringComparator";
+  std::string hash = "fnv1";
+  bool tagged = false;
+  bool soa = false;
+  bool minimal = false;
+  std::vector<std::string> includes;
+  std::string header = "const_hashmap.h";
+  std::string input;
+  std::string output;
+};
+
+struct Entry {
+  std::string key;
+  std::string value;
+};
+
+// as a C++ string literal. octal escapes take at most three digits, so a
+// digit after one cannot be read as part of it
+std::string quote(const std::string& src) {
+  std::string res = "\"";
+  for (unsigned char c : src) {
+    if (c == '"' || c == '\\') {
+      res += '\\';
+      res += static_cast<char>(c);
+    } else if (c < 0x20 || c >= 0x7F) {
+      char buf[5];
+      std::snprintf(buf, sizeof(buf), "\\%03o", c);
+      res += buf;
+    } else {
+      res += static_cast<char>(c);
+    }
+  }
+  return res + "\"";
+}
+
+bool readEntries(std::istream& in, std::vector<Entry>& entries) {
+  std::set<std::string> seen;
+  std::string line;
+  for (size_t lineNo = 1; std::getline(in, line); lineNo++) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      continue;
+    }
+    size_t tab = line.find('\t');
+    if (tab == std::string::npos || tab + 1 == line.size()) {
+      std::cerr << "line " << lineNo << ": expected key<TAB>value\n";
+      return false;
+    }
+    Entry entry{line.substr(0, tab), line.substr(tab + 1)};
+    if (entry.key.find('\0') != std::string::npos) {
+      std::cerr << "line " << lineNo << ": keys cannot hold NUL\n";
+      return false;
+    }
+    if (!seen.insert(entry.key).second) {
+      std::cerr << "line " << lineNo << ": duplicate key " << quote(entry.key)
+                << "\n";
+      return false;
+    }
+    entries.push_back(std::move(entry));
+  }
+  if (entries.empty()) {
+    std::cerr << "no keys\n";
+    return false;
+  }
+  return true;
+}
+
+// as one braced std::array argument, perLine numbers to a line
+template <typename T>
+void writeNumbers(std::ostream& out, const std::vector<T>& nums,
+                  size_t perLine, const char* suffix) {
+  out << "        {{";
+  for (size_t i = 0; i < nums.size(); i++) {
+    if (i != 0) {
+      out << (i % perLine == 0 ? ",\n          " : ", ");
+    }
+    out << nums[i] << suffix;
+  }
+  out << "}}";
+}
+
+template <typename Hash>
+void writeHeader(std::ostream& out, const Options& opts,
+                 const std::vector<Entry>& entries) {
+  std::vector<const char*> keys;
+  for (const auto& entry : entries) {
+    keys.push_back(entry.key.c_str());
+  }
+  size_t size = keys.size();
+  size_t mapSize = opts.minimal ? size : cexpr::getTableSize(size);
+  size_t bucketCount = cexpr::getBucketCount(size);
+
+  uint32_t seed = 0;
+  std::vector<uint16_t> displacements =
+      cexpr::getDisplacements<Hash>(keys, mapSize, seed);
+  std::vector<const Entry*> slots(mapSize);
+  std::vector<uint32_t> tags(mapSize);
+  // a key with a byte past ASCII if there is one, the target checks it
+  // hashes the way this host did
+  size_t sample = 0;
+  for (size_t i = 0; i < size; i++) {
+    uint32_t hashVal = cexpr::seededHash<Hash>(keys[i], seed);
+    for (unsigned char c : entries[i].key) {
+      if (c >= 0x80 && sample == 0) {
+        sample = i;
+      }
+    }
+    size_t slot = cexpr::getSlot(
+        hashVal, displacements[cexpr::getBucket(hashVal, bucketCount)],
+        mapSize);
+    slots[slot] = &entries[i];
+    tags[slot] = hashVal;
+  }
+
+  out << "// generated by generate_hashmap";
+  if (!opts.input.empty()) {
+    out << " from " << opts.input;
+  }
+  out << ", do not edit\n"
+      << "#pragma once\n"
+      << "#include <array>\n"
+      << "#include <cstdint>\n"
+      << "#include <utility>\n"
+      << "#include \"" << opts.header << "\"\n";
+  for (const auto& include : opts.includes) {
+    out << "#include " << include << "\n";
+  }
+  out << "\n";
+  if (!opts.nameSpace.empty()) {
+    out << "namespace " << opts.nameSpace << " {\n\n";
+  }
+
+  std::string hasher =
+      "cexpr::" + (opts.hash == "wordHash" ? "word" : opts.hash) + "Hasher";
+  out << "// " << size << " keys in " << mapSize << " slots, "
+      << Hash::name << " seed " << seed << "\n"
+      << "inline constexpr cexpr::HashMap<\n"
+      << "    " << size << ", " << mapSize << ", const char*, "
+      << opts.valueType << ", " << opts.comparator << ",\n"
+      << "    " << hasher << ", " << (opts.tagged ? "true" : "false")
+      << ", cexpr::NoInstrumentation,\n"
+      << "    cexpr::" << (opts.soa ? "SoaLayout" : "AosLayout") << ">\n"
+      << "    " << opts.name << "(\n"
+      << "        " << seed << "u,\n";
+  writeNumbers(out, displacements, 12, "");
+  // keys and values go in separate arrays, a braced std::pair per slot
+  // costs the compiler a constructor overload resolution each
+  out << ",\n        {{";
+  for (size_t i = 0; i < mapSize; i++) {
+    if (i != 0) {
+      out << ",\n          ";
+    }
+    out << (slots[i] == nullptr ? "nullptr" : quote(slots[i]->key));
+  }
+  out << "}},\n        {{";
+  for (size_t i = 0; i < mapSize; i++) {
+    if (i != 0) {
+      out << ",\n          ";
+    }
+    out << (slots[i] == nullptr ? "{}" : slots[i]->value);
+  }
+  out << "}}";
+  if (opts.tagged) {
+    out << ",\n";
+    writeNumbers(out, tags, 6, "u");
+  }
+  out << ");\n"
+      << "static_assert(cexpr::seededHash<" << hasher << ">(\n"
+      << "                  " << quote(entries[sample].key) << ", " << seed
+      << "u) == " << cexpr::seededHash<Hash>(keys[sample], seed) << "u,\n"
+      << "              \"the target hashes keys like the generator\");\n";
+
+  if (!opts.nameSpace.empty()) {
+    out << "}\n";
+  }
+}
+
+bool parseOptions(int argc, char** argv, Options& opts) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--name" && hasValue) {
+      opts.name = argv[++i];
+    } else if (arg == "--namespace" && hasValue) {
+      opts.nameSpace = argv[++i];
+    } else if (arg == "--value-type" && hasValue) {
+      opts.valueType = argv[++i];
+    } else if (arg == "--comparator" && hasValue) {
+      opts.comparator = argv[++i];
+    } else if (arg == "--hash" && hasValue) {
+      opts.hash = argv[++i];
+    } else if (arg == "--tagged") {
+      opts.tagged = true;
+    } else if (arg == "--soa") {
+      opts.soa = true;
+    } else if (arg == "--minimal") {
+      opts.minimal = true;
+    } else if (arg == "--include" && hasValue) {
+      std::string include = argv[++i];
+      // bare names are quoted, <...> and "..." are kept
+      if (include[0] != '<' && include[0] != '"') {
+        include = "\"" + include + "\"";
+      }
+      opts.includes.push_back(include);
+    } else if (arg == "--header" && hasValue) {
+      opts.header = argv[++i];
+    } else if (arg == "-o" && hasValue) {
+      opts.output = argv[++i];
+    } else if (arg[0] != '-' || arg == "-") {
+      opts.input = arg == "-" ? "" : arg;
+    } else {
+      std::cerr << "unknown option " << arg << "\n";
+      return false;
+    }
+  }
+  if (opts.hash != "fnv1" && opts.hash != "fnv1a" &&
+      opts.hash != "wordHash") {
+    std::cerr << "unknown hash " << opts.hash << "\n";
+    return false;
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+  Options opts;
+  if (!parseOptions(argc, argv, opts)) {
+    std::cerr << "usage: generate_hashmap [options] [keys.txt]\n";
+    return 2;
+  }
+
+  std::vector<Entry> entries;
+  bool ok = false;
+  if (opts.input.empty()) {
+    ok = readEntries(std::cin, entries);
+  } else {
+    std::ifstream in(opts.input);
+    if (!in) {
+      std::cerr << "cannot read " << opts.input << "\n";
+      return 1;
+    }
+    ok = readEntries(in, entries);
+  }
+  if (!ok) {
+    return 1;
+  }
+
+  // written out only once the table is built, a failed run leaves no
+  // half written header behind
+  std::ostringstream out;
+  try {
+    if (opts.hash == "fnv1") {
+      writeHeader<cexpr::fnv1Hasher>(out, opts, entries);
+    } else if (opts.hash == "fnv1a") {
+      writeHeader<cexpr::fnv1aHasher>(out, opts, entries);
+    } else {
+      writeHeader<cexpr::wordHasher>(out, opts, entries);
+    }
+  } catch (const std::logic_error& err) {
+    std::cerr << err.what() << "\n";
+    return 1;
+  }
+
+  if (opts.output.empty()) {
+    std::cout << out.str();
+  } else {
+    std::ofstream file(opts.output);
+    file << out.str();
+    // close flushes, so a full disk shows up here
+    file.close();
+    if (!file) {
+      std::cerr << "cannot write " << opts.output << "\n";
+      return 1;
+    }
+  }
+  return 0;
+}
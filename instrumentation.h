@@ -0,0 +1,164 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace cexpr {
+
+// lookup instrumentation policies for HashMap. the map only touches the
+// policy outside constant evaluation, and with NoInstrumentation get
+// compiles to the same code as a map without the parameter
+
+struct NoInstrumentation {
+  static constexpr bool enabled = false;
+};
+
+// sampled lookups land in bucket i when they took [2^(i-1), 2^i) cycles,
+// bucket 0 holds the ones that took none
+constexpr size_t lookupHistogramBuckets = 64;
+
+struct LookupSnapshot {
+  uint64_t gets = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  // lookups that reached the comparator, tagged maps skip most misses
+  uint64_t compares = 0;
+  uint64_t samples = 0;
+  std::array<uint64_t, lookupHistogramBuckets> cycles{};
+};
+
+// timestamp counter where there is one, nanoseconds elsewhere
+inline uint64_t readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// counts every lookup and times one in sampleEvery. Tag only tells the
+// tables apart, every map instantiated with the same Instrumented type
+// shares its counters:
+//   struct UrlTable;
+//   HashMap<..., cexpr::Instrumented<UrlTable>> urls(...);
+//   cexpr::Instrumented<UrlTable>::snapshot().misses
+// every thread counts into its own cache line sized block, which it alone
+// writes, so lookups never share a line. the block of an exited thread
+// goes to the next new thread and keeps its counts, so snapshot still
+// sums them and the blocks stay as many as the threads alive at once
+template <typename Tag, uint32_t sampleEvery = 64>
+class Instrumented {
+ public:
+  static constexpr bool enabled = true;
+  static_assert(sampleEvery != 0, "sample at least every so often");
+
+  struct alignas(64) Counters {
+    std::atomic<uint64_t> gets{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> compares{0};
+    std::atomic<uint64_t> samples{0};
+    std::array<std::atomic<uint64_t>, lookupHistogramBuckets> cycles{};
+    std::atomic<bool> owned{false};
+    uint32_t untilSample = 0;
+
+    // true when this lookup should be timed
+    bool sample() {
+      if (untilSample != 0) {
+        untilSample--;
+        return false;
+      }
+      untilSample = sampleEvery - 1;
+      return true;
+    }
+
+    void record(bool hit, bool compared) {
+      bump(gets);
+      bump(hit ? hits : misses);
+      if (compared) {
+        bump(compares);
+      }
+    }
+
+    void recordCycles(uint64_t elapsed) {
+      size_t bucket = elapsed == 0 ? 0 : 64 - __builtin_clzll(elapsed);
+      bump(samples);
+      bump(cycles[bucket < lookupHistogramBuckets
+                      ? bucket
+                      : lookupHistogramBuckets - 1]);
+    }
+  };
+
+  static Counters& local() {
+    static thread_local Owner owner{acquire()};
+    return *owner.counters;
+  }
+
+  static LookupSnapshot snapshot() {
+    LookupSnapshot res;
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    for (const auto& counters : registry().all) {
+      res.gets += counters->gets.load(std::memory_order_relaxed);
+      res.hits += counters->hits.load(std::memory_order_relaxed);
+      res.misses += counters->misses.load(std::memory_order_relaxed);
+      res.compares += counters->compares.load(std::memory_order_relaxed);
+      res.samples += counters->samples.load(std::memory_order_relaxed);
+      for (size_t i = 0; i < lookupHistogramBuckets; i++) {
+        res.cycles[i] += counters->cycles[i].load(std::memory_order_relaxed);
+      }
+    }
+    return res;
+  }
+
+  // blocks handed out so far, the most threads that counted at once
+  static size_t blocks() {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    return registry().all.size();
+  }
+
+ private:
+  struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Counters>> all;
+  };
+
+  // hands the block back to the registry when the thread exits
+  struct Owner {
+    Counters* counters;
+    ~Owner() { counters->owned.store(false, std::memory_order_release); }
+  };
+
+  // only the owning thread writes, so no read-modify-write is needed
+  static void bump(std::atomic<uint64_t>& counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+  }
+
+  static Registry& registry() {
+    static Registry reg;
+    return reg;
+  }
+
+  // a block a thread left behind, or a new one
+  static Counters* acquire() {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    for (const auto& counters : registry().all) {
+      bool expected = false;
+      if (counters->owned.compare_exchange_strong(expected, true)) {
+        return counters.get();
+      }
+    }
+    registry().all.push_back(std::make_unique<Counters>());
+    registry().all.back()->owned.store(true);
+    return registry().all.back().get();
+  }
+};
+}
@@ -0,0 +1,316 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "./const_hashmap.h"
+
+namespace cexpr {
+
+// PooledHashMap for keys only known at runtime, such as tenant ids read at
+// deploy time. serializeHashMap runs the constexpr builder's seed search
+// over the keys and lays the table out as one blob, which MappedHashMap
+// queries where it lies, typically in a read only mapping of a file, with
+// nothing decoded or copied at startup. all positions in the blob are
+// offsets from its start, so it can be mapped anywhere:
+//
+//   header         MappedHeader
+//   displacements  uint16_t[buckets]
+//   slots          PooledSlot<Value>[slots], at the alignment of the slot
+//   pool           the keys in slot order
+//
+// numbers are in the byte order of the writer, a blob written with the
+// other byte order fails the magic check. values are copied bytewise, so
+// they have to be trivially copyable and mean the same in every process,
+// plain numbers or offsets into something else rather than pointers
+
+constexpr uint32_t mappedMagic = 0x48504358;  // "XCPH" in little endian
+// bump on every change to the layout above or to the hashes
+constexpr uint32_t mappedVersion = 2;
+
+struct MappedHeader {
+  uint32_t magic;
+  uint32_t version;
+  // Hash::name of the hasher, NUL padded
+  char hash[16];
+  uint32_t valueSize;
+  uint32_t valueAlign;
+  uint32_t seed;
+  uint32_t keys;
+  uint32_t slots;
+  uint32_t buckets;
+  uint64_t displacementsOffset;
+  uint64_t slotsOffset;
+  uint64_t poolOffset;
+  uint64_t poolSize;
+  // of the whole blob
+  uint64_t size;
+};
+
+namespace mapped {
+
+constexpr uint64_t alignUp(uint64_t offset, uint64_t align) {
+  return (offset + align - 1) / align * align;
+}
+}
+
+// the blob for entries, hashed as slices like MappedHashMap::get does.
+// the same keys and values in the same order give the same bytes, so
+// builds are reproducible. throws std::logic_error when no seed gives a
+// perfect hash, which gets likely past ~150k keys, and
+// std::invalid_argument on duplicate keys
+template <typename Value, typename Hash = fnv1aHasher>
+std::vector<char> serializeHashMap(
+    const std::vector<std::pair<std::string, Value>>& entries) {
+  static_assert(std::is_trivially_copyable_v<Value>,
+                "values are copied bytewise");
+  static_assert(std::is_invocable_v<Hash&, std::string_view, uint32_t> ||
+                    std::is_invocable_v<Hash&, std::string_view>,
+                "the hasher has to take std::string_view");
+  using Slot = PooledSlot<Value>;
+
+  std::vector<std::string_view> keys;
+  keys.reserve(entries.size());
+  uint64_t poolSize = 0;
+  for (const auto& entry : entries) {
+    keys.push_back(entry.first);
+    poolSize += entry.first.size();
+  }
+  if (entries.size() > std::numeric_limits<uint32_t>::max() / 2 ||
+      poolSize > std::numeric_limits<uint32_t>::max()) {
+    throw std::invalid_argument("too many keys for 32 bit offsets");
+  }
+  // duplicates hash alike under every seed, better to say so than to
+  // search all of them
+  std::vector<std::string_view> sorted = keys;
+  std::sort(sorted.begin(), sorted.end());
+  if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+    throw std::invalid_argument("duplicate key");
+  }
+  size_t slotCount = getTableSize(keys.size());
+  size_t bucketCount = getBucketCount(keys.size());
+  uint32_t seed = 0;
+  std::vector<uint16_t> displacements =
+      getDisplacements<Hash>(keys, slotCount, seed);
+
+  MappedHeader header{};
+  header.magic = mappedMagic;
+  header.version = mappedVersion;
+  std::strncpy(header.hash, HashName<Hash>::value, sizeof(header.hash) - 1);
+  header.valueSize = sizeof(Value);
+  header.valueAlign = alignof(Value);
+  header.seed = seed;
+  header.keys = static_cast<uint32_t>(keys.size());
+  header.slots = static_cast<uint32_t>(slotCount);
+  header.buckets = static_cast<uint32_t>(bucketCount);
+  header.displacementsOffset = sizeof(MappedHeader);
+  header.slotsOffset =
+      mapped::alignUp(header.displacementsOffset + 2 * bucketCount,
+                      alignof(Slot) < 8 ? 8 : alignof(Slot));
+  header.poolOffset = header.slotsOffset + sizeof(Slot) * slotCount;
+  header.poolSize = poolSize;
+  header.size = header.poolOffset + poolSize;
+
+  // zero filled, so the padding of the slots is the same in every build
+  std::vector<char> blob(header.size);
+  std::memcpy(blob.data(), &header, sizeof(header));
+  std::memcpy(blob.data() + header.displacementsOffset, displacements.data(),
+              2 * bucketCount);
+
+  std::vector<size_t> keyOf(slotCount, entries.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    uint32_t hashVal = seededHash<Hash>(keys[i], seed);
+    keyOf[getSlot(hashVal, displacements[getBucket(hashVal, bucketCount)],
+                  slotCount)] = i;
+  }
+  uint64_t offset = 0;
+  for (size_t slot = 0; slot < slotCount; slot++) {
+    Slot res{};
+    if (keyOf[slot] != entries.size()) {
+      const auto& entry = entries[keyOf[slot]];
+      res.offset = static_cast<uint32_t>(offset);
+      res.length = static_cast<uint32_t>(entry.first.size());
+      res.value = entry.second;
+      std::memcpy(blob.data() + header.poolOffset + offset,
+                  entry.first.data(), entry.first.size());
+      offset += entry.first.size();
+    }
+    // member by member, a copy of the whole slot could carry stack bytes
+    // from its padding
+    char* dst = blob.data() + header.slotsOffset + sizeof(Slot) * slot;
+    std::memcpy(dst + offsetof(Slot, offset), &res.offset,
+                sizeof(res.offset));
+    std::memcpy(dst + offsetof(Slot, length), &res.length,
+                sizeof(res.length));
+    std::memcpy(dst + offsetof(Slot, value), &res.value, sizeof(res.value));
+  }
+  return blob;
+}
+
+// queries a serializeHashMap blob in place, the blob has to outlive it.
+// the constructor only checks the header and that every section lies in
+// the blob, and throws std::runtime_error when they do not. slots are not
+// visited, a lookup checks its key offset against the pool instead, so a
+// damaged blob gives wrong values but never reads outside of it
+template <typename Value, typename Hash = fnv1aHasher>
+class MappedHashMap {
+  using Slot = PooledSlot<Value>;
+
+ public:
+  MappedHashMap(const void* data, size_t size) {
+    static_assert(std::is_trivially_copyable_v<Value>,
+                  "values are copied bytewise");
+    const char* base = static_cast<const char*>(data);
+    if (size < sizeof(MappedHeader) ||
+        reinterpret_cast<uintptr_t>(base) % alignof(MappedHeader) != 0) {
+      throw std::runtime_error("not a mapped hash map");
+    }
+    const auto& header = *reinterpret_cast<const MappedHeader*>(base);
+    if (header.magic != mappedMagic) {
+      throw std::runtime_error("not a mapped hash map");
+    }
+    if (header.version != mappedVersion) {
+      throw std::runtime_error("mapped hash map version " +
+                               std::to_string(header.version) +
+                               ", expected " + std::to_string(mappedVersion));
+    }
+    std::string_view hashName(header.hash,
+                              strnlen(header.hash, sizeof(header.hash)));
+    if (hashName != std::string_view(HashName<Hash>::value)
+                        .substr(0, sizeof(header.hash) - 1)) {
+      throw std::runtime_error("mapped hash map hashed with another hasher");
+    }
+    if (header.valueSize != sizeof(Value) ||
+        header.valueAlign != alignof(Value)) {
+      throw std::runtime_error("mapped hash map holds another value type");
+    }
+    if (header.slots == 0 || header.slots < header.keys ||
+        header.buckets != getBucketCount(header.keys) ||
+        header.size > size ||
+        header.displacementsOffset % alignof(uint16_t) != 0 ||
+        header.slotsOffset % alignof(Slot) != 0 ||
+        !inside(header, header.displacementsOffset,
+                2 * uint64_t(header.buckets)) ||
+        !inside(header, header.slotsOffset,
+                sizeof(Slot) * uint64_t(header.slots)) ||
+        !inside(header, header.poolOffset, header.poolSize)) {
+      throw std::runtime_error("mapped hash map is truncated or damaged");
+    }
+    seed_ = header.seed;
+    keys_ = header.keys;
+    buckets_ = FastMod(header.buckets);
+    slotCount_ = FastMod(header.slots);
+    displacements_ =
+        reinterpret_cast<const uint16_t*>(base + header.displacementsOffset);
+    slots_ = reinterpret_cast<const Slot*>(base + header.slotsOffset);
+    pool_ = base + header.poolOffset;
+    poolSize_ = header.poolSize;
+  }
+
+  Value get(std::string_view key) const {
+    uint32_t hashVal = seededHash<Hash>(key, seed_);
+    const Slot& slot = slots_[slotCount_(
+        displace(hashVal, displacements_[buckets_(hashVal)]))];
+    if (slot.length != key.size() ||
+        uint64_t(slot.offset) + slot.length > poolSize_ ||
+        (key.size() != 0 &&
+         std::memcmp(pool_ + slot.offset, key.data(), key.size()) != 0)) {
+      return Value();
+    }
+    return slot.value;
+  }
+
+  Value get(const char* key) const { return get(std::string_view(key)); }
+
+  Value get(const char* key, size_t len) const {
+    return get(std::string_view(key, len));
+  }
+
+  size_t size() const { return keys_; }
+
+  // the hash seed the builder settled on
+  uint32_t seed() const { return seed_; }
+
+ private:
+  static bool inside(const MappedHeader& header, uint64_t offset,
+                     uint64_t len) {
+    return offset >= sizeof(MappedHeader) && offset <= header.size &&
+           len <= header.size - offset;
+  }
+
+  uint32_t seed_ = 0;
+  uint32_t keys_ = 0;
+  FastMod buckets_;
+  FastMod slotCount_;
+  const uint16_t* displacements_ = nullptr;
+  const Slot* slots_ = nullptr;
+  const char* pool_ = nullptr;
+  uint64_t poolSize_ = 0;
+};
+
+#if __has_include(<sys/mman.h>)
+// a whole file mapped read only, unmapped again on destruction. pages are
+// only read in as lookups touch them, and processes mapping the same file
+// share them. throws std::runtime_error when the file cannot be mapped
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::runtime_error("cannot open " + path);
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      throw std::runtime_error("cannot map " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data_ == MAP_FAILED) {
+      data_ = nullptr;
+      throw std::runtime_error("cannot map " + path);
+    }
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept
+      : data_(std::exchange(other.data_, nullptr)),
+        size_(std::exchange(other.size_, 0)) {}
+
+  MappedFile& operator=(MappedFile&& other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+
+  ~MappedFile() {
+    if (data_ != nullptr) {
+      ::munmap(data_, size_);
+    }
+  }
+
+  const void* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  void* data_ = nullptr;
+  size_t size_ = 0;
+};
+#endif
+}
@@ -0,0 +1,283 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include "./base.h"
+
+namespace cexpr {
+
+// route patterns are literal text with two kinds of placeholders:
+//   {name}  matches one non-empty path segment, up to the next '/'
+//   *       only at the end, matches the rest of the path
+// parameters are captured by position, the names are only documentation
+
+// every route adds at most a split node and a new node per literal run,
+// plus one node per parameter
+template <typename T, size_t size>
+constexpr size_t getRouterNodeCount(const std::array<T, size>& routes) {
+  size_t nodes = 1;
+  for (size_t i = 0; i < size; i++) {
+    size_t params = 0;
+    for (const char* src = routes[i].first; *src != '\0'; src++) {
+      params += *src == '{';
+    }
+    nodes += 2 * (params + 1) + params;
+  }
+  return nodes;
+}
+
+// the most parameters any single route captures
+template <typename T, size_t size>
+constexpr size_t getRouterParamCount(const std::array<T, size>& routes) {
+  size_t maxParams = 0;
+  for (size_t i = 0; i < size; i++) {
+    size_t params = 0;
+    for (const char* src = routes[i].first; *src != '\0'; src++) {
+      params += *src == '{';
+    }
+    maxParams = params > maxParams ? params : maxParams;
+  }
+  return maxParams;
+}
+
+struct RouterNode {
+  static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+  // literal edge leading into this node, points into the route pattern
+  const char* label = nullptr;
+  size_t labelLen = 0;
+  // literal children are chained through nextSibling, and no two of them
+  // start with the same character
+  size_t firstChild = none;
+  size_t nextSibling = none;
+  size_t paramChild = none;
+  size_t route = none;
+  size_t wildcardRoute = none;
+};
+
+// std::pair is not assignable in constant expressions before C++20
+struct RouteParam {
+  size_t offset = 0;
+  size_t length = 0;
+};
+
+template <typename Handler, size_t maxParams>
+struct RouteMatch {
+  // Handler() when no route matched
+  Handler handler{};
+  bool found = false;
+  size_t paramCount = 0;
+  // where every captured parameter sits in the path
+  std::array<RouteParam, maxParams> params{};
+  // offset of the text matched by a trailing *, the path length otherwise
+  size_t wildcardOffset = 0;
+
+  constexpr explicit operator bool() const { return found; }
+
+  constexpr std::string_view param(std::string_view path, size_t idx) const {
+    return path.substr(params[idx].offset, params[idx].length);
+  }
+};
+
+// compile time radix tree over url paths. a lookup walks the path,
+// preferring a literal edge over a parameter and taking the parameter when
+// the literal edge leads to no route, and falls back to the route ending
+// in * that covers the longest part of the path. a literal segment
+// therefore shadows a parameter at the same position only where it matches
+template <size_t bufSize, size_t nodeCount, size_t maxParams,
+          typename Handler>
+class Router {
+ public:
+  constexpr Router(const std::array<std::pair<const char*, Handler>, bufSize>&
+                       routes)
+      : nodes_{}, handlers_{}, used_(1) {
+    for (size_t i = 0; i < bufSize; i++) {
+      handlers_[i] = routes[i].second;
+      insert(routes[i].first, i);
+    }
+  }
+
+  constexpr RouteMatch<Handler, maxParams> match(std::string_view path) const {
+    RouteMatch<Handler, maxParams> res{};
+    RouteMatch<Handler, maxParams> fallback{};
+    if (matchFrom(path, 0, 0, res, fallback)) {
+      return res;
+    }
+    return fallback;
+  }
+
+  constexpr Handler get(std::string_view path) const {
+    return match(path).handler;
+  }
+
+  // nodes the tree actually needs, at most nodeCount
+  constexpr size_t size() const { return used_; }
+
+ private:
+  // walks down from node, which the path reached at pos. res holds the
+  // parameters captured on the way and the route once this returns true.
+  // fallback keeps the route ending in * that covers most of the path
+  constexpr bool matchFrom(std::string_view path, size_t node, size_t pos,
+                           RouteMatch<Handler, maxParams>& res,
+                           RouteMatch<Handler, maxParams>& fallback) const {
+    const RouterNode& cur = nodes_[node];
+    if (cur.wildcardRoute != RouterNode::none &&
+        (!fallback.found || pos > fallback.wildcardOffset)) {
+      fallback = res;
+      fallback.handler = handlers_[cur.wildcardRoute];
+      fallback.found = true;
+      fallback.wildcardOffset = pos;
+    }
+    if (pos == path.size()) {
+      if (cur.route == RouterNode::none) {
+        return false;
+      }
+      res.handler = handlers_[cur.route];
+      res.found = true;
+      res.wildcardOffset = pos;
+      return true;
+    }
+
+    // a literal edge can end inside a segment the parameter would take
+    // whole, so the parameter is tried when the literal leads nowhere
+    size_t child = findChild(cur, path[pos]);
+    if (child != RouterNode::none && startsWith(path, pos, nodes_[child]) &&
+        matchFrom(path, child, pos + nodes_[child].labelLen, res, fallback)) {
+      return true;
+    }
+
+    if (cur.paramChild != RouterNode::none) {
+      size_t end = pos;
+      while (end != path.size() && path[end] != '/') {
+        end++;
+      }
+      if (end != pos) {
+        size_t count = res.paramCount;
+        res.params[count].offset = pos;
+        res.params[count].length = end - pos;
+        res.paramCount = count + 1;
+        if (matchFrom(path, cur.paramChild, end, res, fallback)) {
+          return true;
+        }
+        res.paramCount = count;
+      }
+    }
+    return false;
+  }
+
+  constexpr size_t findChild(const RouterNode& node, char c) const {
+    size_t child = node.firstChild;
+    while (child != RouterNode::none && nodes_[child].label[0] != c) {
+      child = nodes_[child].nextSibling;
+    }
+    return child;
+  }
+
+  static constexpr bool startsWith(std::string_view path, size_t pos,
+                                   const RouterNode& node) {
+    if (path.size() - pos < node.labelLen) {
+      return false;
+    }
+    for (size_t i = 0; i < node.labelLen; i++) {
+      if (path[pos + i] != node.label[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  constexpr size_t addNode() {
+    if (used_ == nodeCount) {
+      throw std::logic_error("router node count is too small");
+    }
+    return used_++;
+  }
+
+  // walk or extend the tree by the literal run [src, src + len)
+  constexpr size_t insertLiteral(size_t node, const char* src, size_t len) {
+    while (len != 0) {
+      size_t child = findChild(nodes_[node], *src);
+      if (child == RouterNode::none) {
+        child = addNode();
+        nodes_[child].label = src;
+        nodes_[child].labelLen = len;
+        nodes_[child].nextSibling = nodes_[node].firstChild;
+        nodes_[node].firstChild = child;
+        return child;
+      }
+
+      size_t common = 0;
+      while (common != len && common != nodes_[child].labelLen &&
+             src[common] == nodes_[child].label[common]) {
+        common++;
+      }
+      if (common != nodes_[child].labelLen) {
+        // split the edge, the tail keeps everything below the child
+        size_t tail = addNode();
+        nodes_[tail] = nodes_[child];
+        nodes_[tail].label += common;
+        nodes_[tail].labelLen -= common;
+        nodes_[tail].nextSibling = RouterNode::none;
+        RouterNode head{};
+        head.label = nodes_[child].label;
+        head.labelLen = common;
+        head.firstChild = tail;
+        head.nextSibling = nodes_[child].nextSibling;
+        nodes_[child] = head;
+      }
+      node = child;
+      src += common;
+      len -= common;
+    }
+    return node;
+  }
+
+  constexpr void insert(const char* pattern, size_t route) {
+    size_t node = 0;
+    while (*pattern != '\0') {
+      if (*pattern == '*') {
+        if (pattern[1] != '\0') {
+          throw std::logic_error("* must end the route");
+        }
+        if (nodes_[node].wildcardRoute != RouterNode::none) {
+          throw std::logic_error("duplicate route");
+        }
+        nodes_[node].wildcardRoute = route;
+        return;
+      }
+      if (*pattern == '{') {
+        while (*pattern != '}') {
+          if (*pattern == '\0') {
+            throw std::logic_error("unterminated route parameter");
+          }
+          pattern++;
+        }
+        pattern++;
+        if (nodes_[node].paramChild == RouterNode::none) {
+          nodes_[node].paramChild = addNode();
+        }
+        node = nodes_[node].paramChild;
+        continue;
+      }
+      size_t len = 0;
+      while (pattern[len] != '\0' && pattern[len] != '{' &&
+             pattern[len] != '*') {
+        len++;
+      }
+      node = insertLiteral(node, pattern, len);
+      pattern += len;
+    }
+    if (nodes_[node].route != RouterNode::none) {
+      throw std::logic_error("duplicate route");
+    }
+    nodes_[node].route = route;
+  }
+
+  std::array<RouterNode, nodeCount> nodes_;
+  std::array<Handler, bufSize> handlers_;
+  size_t used_;
+};
+}
@@ -0,0 +1,257 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include "./const_hashmap.h"
+
+namespace cexpr {
+
+// two level perfect hash for key sets too large for one constant
+// expression. the seed 0 hash of a key picks its shard, and every shard
+// is a small hash and displace table of its own, with its own seed search.
+// a lookup reads the shard entry, one cache line, then the displacement
+// and the slot like HashMap does
+//
+// the seed searches are the expensive part and can be split over several
+// constant expressions, or translation units, and merged:
+//   constexpr auto low = cexpr::getShardTables<hash, 64>(keys, 0, 32);
+//   constexpr auto high = cexpr::getShardTables<hash, 64>(keys, 32, 64);
+//   constexpr cexpr::ShardedHashMap<keys.size(), 64, ...> map(
+//       keys, cexpr::mergeShardTables(low, high));
+// placing the keys afterwards hashes every key once more and nothing else
+
+// about 256 keys per shard, where the seed search of a shard is short
+constexpr size_t getShardCount(size_t size) { return size / 256 + 1; }
+
+// upper bounds for the per shard tables of getTableSize and
+// getBucketCount laid end to end
+constexpr size_t getShardedSlotCount(size_t size, size_t shardCount) {
+  return size + size / 8 + shardCount;
+}
+
+constexpr size_t getShardedBucketCount(size_t size, size_t shardCount) {
+  return size / 2 + shardCount;
+}
+
+// the shard of a key, from its seed 0 hash. mixed first, the buckets of
+// the shard are picked by the low bits of the same hash
+template <size_t shardCount>
+constexpr size_t getShard(uint32_t topHash) {
+  return static_cast<size_t>(
+      (static_cast<uint64_t>(displace(topHash, 0)) * shardCount) >> 32);
+}
+
+// where the tables of every shard start. a shard of n keys has
+// getBucketCount(n) buckets and getTableSize(n) slots
+template <size_t shardCount>
+struct ShardLayout {
+  std::array<uint32_t, shardCount> keys{};
+  std::array<uint32_t, shardCount + 1> bucketStart{};
+  std::array<uint32_t, shardCount + 1> slotStart{};
+};
+
+template <typename Hash, size_t shardCount, typename T, size_t size>
+constexpr ShardLayout<shardCount> getShardLayout(
+    const std::array<T, size>& buf) {
+  ShardLayout<shardCount> layout{};
+  for (size_t i = 0; i < size; i++) {
+    layout.keys[getShard<shardCount>(
+        seededHash<Hash>(getFirst<T>(buf[i]), 0))]++;
+  }
+  for (size_t i = 0; i < shardCount; i++) {
+    layout.bucketStart[i + 1] = static_cast<uint32_t>(
+        layout.bucketStart[i] + getBucketCount(layout.keys[i]));
+    layout.slotStart[i + 1] = static_cast<uint32_t>(
+        layout.slotStart[i] + getTableSize(layout.keys[i]));
+  }
+  return layout;
+}
+
+// what the seed searches of some shards found
+template <size_t shardCount, size_t bucketCount>
+struct ShardTables {
+  std::array<uint32_t, shardCount> seeds{};
+  std::array<bool, shardCount> built{};
+  // shard i owns [bucketStart[i], bucketStart[i + 1])
+  std::array<uint32_t, shardCount + 1> bucketStart{};
+  std::array<uint16_t, bucketCount> displacements{};
+};
+
+namespace sharded {
+// the displacements of one shard, inside the array of all of them
+template <typename Displacements>
+struct Window {
+  constexpr uint16_t& operator[](size_t idx) {
+    return getRef(all, offset + idx);
+  }
+
+  Displacements& all;
+  size_t offset;
+};
+}
+
+// runs the seed searches of shards [first, last) and leaves the others
+// unbuilt. throws std::logic_error when no seed fits a shard, which only
+// gets likely for shards well past a hundred thousand keys
+template <typename Hash, size_t shardCount, typename T, size_t size>
+constexpr ShardTables<shardCount, getShardedBucketCount(size, shardCount)>
+getShardTables(const std::array<T, size>& buf, size_t first = 0,
+               size_t last = shardCount) {
+  constexpr size_t bucketCount = getShardedBucketCount(size, shardCount);
+  constexpr uint32_t seedCount = getSeedCount<Hash, typename T::first_type>();
+  auto layout = getShardLayout<Hash, shardCount>(buf);
+  ShardTables<shardCount, bucketCount> tables{};
+  tables.bucketStart = layout.bucketStart;
+
+  // the keys grouped by shard
+  std::array<uint32_t, shardCount + 1> keyStart{};
+  for (size_t i = 0; i < shardCount; i++) {
+    keyStart[i + 1] = keyStart[i] + layout.keys[i];
+  }
+  std::array<uint32_t, shardCount> cursor{};
+  std::array<size_t, size> order{};
+  std::array<uint32_t, size> topHashes{};
+  for (size_t i = 0; i < size; i++) {
+    topHashes[i] = seededHash<Hash>(getFirst<T>(buf[i]), 0);
+    size_t shard = getShard<shardCount>(topHashes[i]);
+    order[keyStart[shard] + cursor[shard]++] = i;
+  }
+
+  // sized for the largest shard there could be, and shared by all
+  DisplacementWorkspace<size, bucketCount,
+                        getShardedSlotCount(size, shardCount)>
+      ws{};
+  std::array<uint32_t, size> hashes{};
+  for (size_t shard = first; shard < last && shard < shardCount; shard++) {
+    size_t keys = layout.keys[shard];
+    sharded::Window<std::array<uint16_t, bucketCount>> window{
+        tables.displacements, layout.bucketStart[shard]};
+    bool placed = false;
+    for (uint32_t seed = 0; seed < seedCount && !placed; seed++) {
+      for (size_t i = 0; i < keys; i++) {
+        size_t key = order[keyStart[shard] + i];
+        hashes[i] = seed == 0 ? topHashes[key]
+                              : seededHash<Hash>(getFirst<T>(buf[key]), seed);
+      }
+      placed = buildDisplacements(hashes, keys, window,
+                                  getBucketCount(keys), getTableSize(keys),
+                                  ws);
+      tables.seeds[shard] = seed;
+    }
+    if (!placed) {
+      throw std::logic_error("no hash seed gives a perfect hash for a shard");
+    }
+    tables.built[shard] = true;
+  }
+  return tables;
+}
+
+// the shards built in either, preferring lhs
+template <size_t shardCount, size_t bucketCount>
+constexpr ShardTables<shardCount, bucketCount> mergeShardTables(
+    const ShardTables<shardCount, bucketCount>& lhs,
+    const ShardTables<shardCount, bucketCount>& rhs) {
+  ShardTables<shardCount, bucketCount> res = lhs;
+  for (size_t i = 0; i < shardCount; i++) {
+    if (res.built[i] || !rhs.built[i]) {
+      continue;
+    }
+    res.seeds[i] = rhs.seeds[i];
+    res.built[i] = true;
+    for (size_t j = rhs.bucketStart[i]; j < rhs.bucketStart[i + 1]; j++) {
+      res.displacements[j] = rhs.displacements[j];
+    }
+  }
+  return res;
+}
+
+template <size_t bufSize, size_t shardCount, typename Key, typename Value,
+          typename Comparator, typename hash>
+class ShardedHashMap {
+ public:
+  static constexpr size_t bucketCount =
+      getShardedBucketCount(bufSize, shardCount);
+  static constexpr size_t slotCount = getShardedSlotCount(bufSize, shardCount);
+  using Tables = ShardTables<shardCount, bucketCount>;
+
+  // a cache line per shard, everything a lookup needs before the
+  // displacement
+  struct alignas(64) Shard {
+    uint32_t seed = 0;
+    uint32_t bucketStart = 0;
+    uint32_t slotStart = 0;
+    FastMod buckets;
+    FastMod slots;
+  };
+
+  // bytes taken by the shards, the displacements and the slots
+  static constexpr size_t footprint =
+      sizeof(std::array<Shard, shardCount>) +
+      sizeof(std::array<uint16_t, bucketCount>) +
+      sizeof(std::array<std::pair<Key, Value>, slotCount>);
+
+  constexpr ShardedHashMap(
+      const std::array<std::pair<Key, Value>, bufSize>& arr)
+      : ShardedHashMap(arr, getShardTables<hash, shardCount>(arr)) {}
+
+  // with seed searches run beforehand, see getShardTables
+  constexpr ShardedHashMap(
+      const std::array<std::pair<Key, Value>, bufSize>& arr,
+      const Tables& tables)
+      : shards_{}, displacements_(tables.displacements), slots_{} {
+    auto layout = getShardLayout<hash, shardCount>(arr);
+    for (size_t i = 0; i < shardCount; i++) {
+      if (!tables.built[i]) {
+        throw std::logic_error("every shard has to be built");
+      }
+      getRef(shards_, i).seed = tables.seeds[i];
+      getRef(shards_, i).bucketStart = layout.bucketStart[i];
+      getRef(shards_, i).slotStart = layout.slotStart[i];
+      getRef(shards_, i).buckets =
+          FastMod(static_cast<uint32_t>(getBucketCount(layout.keys[i])));
+      getRef(shards_, i).slots =
+          FastMod(static_cast<uint32_t>(getTableSize(layout.keys[i])));
+    }
+    for (size_t i = 0; i < bufSize; i++) {
+      size_t slot = slotOf(arr[i].first);
+      getRef(slots_, slot).first = arr[i].first;
+      getRef(slots_, slot).second = arr[i].second;
+    }
+  }
+
+  constexpr Value get(const Key& key) const {
+    const auto& slot = slots_[slotOf(key)];
+    Comparator compare;
+    if (compare(key, slot.first) == 0) {
+      return slot.second;
+    }
+    return Value();
+  }
+
+  // seed searches that needed more than one seed
+  constexpr size_t reseeded() const {
+    size_t res = 0;
+    for (const auto& shard : shards_) {
+      res += shard.seed != 0;
+    }
+    return res;
+  }
+
+ private:
+  constexpr size_t slotOf(const Key& key) const {
+    uint32_t topHash = seededHash<hash>(key, 0);
+    const Shard& shard = shards_[getShard<shardCount>(topHash)];
+    // most shards keep seed 0 and reuse the hash
+    uint32_t hashVal =
+        shard.seed == 0 ? topHash : seededHash<hash>(key, shard.seed);
+    uint16_t displacement =
+        displacements_[shard.bucketStart + shard.buckets(hashVal)];
+    return shard.slotStart + shard.slots(displace(hashVal, displacement));
+  }
+
+  std::array<Shard, shardCount> shards_;
+  std::array<uint16_t, bucketCount> displacements_;
+  std::array<std::pair<Key, Value>, slotCount> slots_;
+};
+}
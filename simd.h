@@ -0,0 +1,303 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace cexpr {
+
+// runtime kernels behind count, find and adjacent_find in algorithm.h.
+// they only cover contiguous ranges of integers, where equality is
+// bytewise, and finish the tail that does not fill a vector with a plain
+// loop. without SSE2 nothing is covered and the constexpr loops run
+
+#if defined(__AVX2__)
+#define CEXPR_SIMD 1
+struct SimdVec {
+  using type = __m256i;
+  static constexpr size_t bytes = 32;
+  static constexpr bool has64 = true;
+
+  static type zero() { return _mm256_setzero_si256(); }
+
+  static type load(const void* src) {
+    return _mm256_loadu_si256(static_cast<const __m256i*>(src));
+  }
+
+  static void store(void* dst, type val) {
+    _mm256_storeu_si256(static_cast<__m256i*>(dst), val);
+  }
+
+  template <typename T>
+  static type set1(T val) {
+    if constexpr (sizeof(T) == 1) {
+      return _mm256_set1_epi8(static_cast<char>(val));
+    } else if constexpr (sizeof(T) == 2) {
+      return _mm256_set1_epi16(static_cast<short>(val));
+    } else if constexpr (sizeof(T) == 4) {
+      return _mm256_set1_epi32(static_cast<int>(val));
+    } else {
+      return _mm256_set1_epi64x(static_cast<long long>(val));
+    }
+  }
+
+  // all ones in every lane where lhs and rhs are equal
+  template <typename T>
+  static type eq(type lhs, type rhs) {
+    if constexpr (sizeof(T) == 1) {
+      return _mm256_cmpeq_epi8(lhs, rhs);
+    } else if constexpr (sizeof(T) == 2) {
+      return _mm256_cmpeq_epi16(lhs, rhs);
+    } else if constexpr (sizeof(T) == 4) {
+      return _mm256_cmpeq_epi32(lhs, rhs);
+    } else {
+      return _mm256_cmpeq_epi64(lhs, rhs);
+    }
+  }
+
+  template <typename T>
+  static type sub(type lhs, type rhs) {
+    if constexpr (sizeof(T) == 1) {
+      return _mm256_sub_epi8(lhs, rhs);
+    } else if constexpr (sizeof(T) == 2) {
+      return _mm256_sub_epi16(lhs, rhs);
+    } else if constexpr (sizeof(T) == 4) {
+      return _mm256_sub_epi32(lhs, rhs);
+    } else {
+      return _mm256_sub_epi64(lhs, rhs);
+    }
+  }
+
+  // one bit per byte
+  static uint32_t mask(type val) {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(val));
+  }
+};
+#elif defined(__SSE2__)
+#define CEXPR_SIMD 1
+struct SimdVec {
+  using type = __m128i;
+  static constexpr size_t bytes = 16;
+  // 64 bit lanes can only be compared from SSE4.1 on, emulating it with
+  // 32 bit compares loses to the scalar loop
+#if defined(__SSE4_1__)
+  static constexpr bool has64 = true;
+#else
+  static constexpr bool has64 = false;
+#endif
+
+  static type zero() { return _mm_setzero_si128(); }
+
+  static type load(const void* src) {
+    return _mm_loadu_si128(static_cast<const __m128i*>(src));
+  }
+
+  static void store(void* dst, type val) {
+    _mm_storeu_si128(static_cast<__m128i*>(dst), val);
+  }
+
+  template <typename T>
+  static type set1(T val) {
+    if constexpr (sizeof(T) == 1) {
+      return _mm_set1_epi8(static_cast<char>(val));
+    } else if constexpr (sizeof(T) == 2) {
+      return _mm_set1_epi16(static_cast<short>(val));
+    } else if constexpr (sizeof(T) == 4) {
+      return _mm_set1_epi32(static_cast<int>(val));
+    } else {
+      return _mm_set1_epi64x(static_cast<long long>(val));
+    }
+  }
+
+  template <typename T>
+  static type eq(type lhs, type rhs) {
+    if constexpr (sizeof(T) == 1) {
+      return _mm_cmpeq_epi8(lhs, rhs);
+    } else if constexpr (sizeof(T) == 2) {
+      return _mm_cmpeq_epi16(lhs, rhs);
+    } else if constexpr (sizeof(T) == 4) {
+      return _mm_cmpeq_epi32(lhs, rhs);
+    } else {
+#if defined(__SSE4_1__)
+      return _mm_cmpeq_epi64(lhs, rhs);
+#else
+      // never called, has64 keeps 64 bit lanes away
+      return lhs;
+#endif
+    }
+  }
+
+  template <typename T>
+  static type sub(type lhs, type rhs) {
+    if constexpr (sizeof(T) == 1) {
+      return _mm_sub_epi8(lhs, rhs);
+    } else if constexpr (sizeof(T) == 2) {
+      return _mm_sub_epi16(lhs, rhs);
+    } else if constexpr (sizeof(T) == 4) {
+      return _mm_sub_epi32(lhs, rhs);
+    } else {
+      return _mm_sub_epi64(lhs, rhs);
+    }
+  }
+
+  static uint32_t mask(type val) {
+    return static_cast<uint32_t>(_mm_movemask_epi8(val));
+  }
+};
+#endif
+
+template <typename T>
+constexpr bool hasSimdEquality() {
+#if defined(CEXPR_SIMD)
+  return std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+         (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 ||
+          (sizeof(T) == 8 && SimdVec::has64));
+#else
+  return false;
+#endif
+}
+
+// iterators that are plain pointers to such integers, compared against a
+// value of the element type
+template <typename It,
+          typename Val = std::remove_cv_t<std::remove_pointer_t<It>>>
+constexpr bool isSimdRange =
+    std::is_pointer<It>::value &&
+    std::is_same<std::remove_cv_t<std::remove_pointer_t<It>>, Val>::value &&
+    hasSimdEquality<Val>();
+
+#if defined(CEXPR_SIMD)
+template <typename T>
+size_t countEqual(const T* first, const T* last, T val) {
+  using Lane = std::make_unsigned_t<T>;
+  constexpr ptrdiff_t lanes = SimdVec::bytes / sizeof(T);
+  // a matching lane compares to all ones, minus one, so subtracting the
+  // comparison counts per lane. 8 bit lanes are emptied before they wrap
+  constexpr ptrdiff_t steps = 255;
+  auto needle = SimdVec::set1(val);
+  size_t cnt = 0;
+  while (last - first >= lanes) {
+    auto acc = SimdVec::zero();
+    for (ptrdiff_t i = 0; i != steps && last - first >= lanes; i++) {
+      acc = SimdVec::sub<T>(acc,
+                            SimdVec::eq<T>(SimdVec::load(first), needle));
+      first += lanes;
+    }
+    Lane parts[lanes];
+    SimdVec::store(parts, acc);
+    for (Lane part : parts) {
+      cnt += part;
+    }
+  }
+  for (; first != last; ++first) {
+    cnt += *first == val;
+  }
+  return cnt;
+}
+
+template <typename T>
+const T* findEqual(const T* first, const T* last, T val) {
+  constexpr ptrdiff_t lanes = SimdVec::bytes / sizeof(T);
+  auto needle = SimdVec::set1(val);
+  for (; last - first >= lanes; first += lanes) {
+    uint32_t bits =
+        SimdVec::mask(SimdVec::eq<T>(SimdVec::load(first), needle));
+    if (bits != 0) {
+      return first + __builtin_ctz(bits) / sizeof(T);
+    }
+  }
+  for (; first != last; ++first) {
+    if (*first == val) {
+      return first;
+    }
+  }
+  return last;
+}
+
+// first element equal to its successor, or last
+template <typename T>
+const T* adjacentEqual(const T* first, const T* last) {
+  if (first == last) {
+    return last;
+  }
+  constexpr ptrdiff_t lanes = SimdVec::bytes / sizeof(T);
+  for (; last - first > lanes; first += lanes) {
+    uint32_t bits = SimdVec::mask(
+        SimdVec::eq<T>(SimdVec::load(first), SimdVec::load(first + 1)));
+    if (bits != 0) {
+      return first + __builtin_ctz(bits) / sizeof(T);
+    }
+  }
+  for (const T* next = first + 1; next != last; ++next, ++first) {
+    if (*first == *next) {
+      return first;
+    }
+  }
+  return last;
+}
+#endif
+
+// running sums of 4 byte integers, behind inclusive_scan and
+// exclusive_scan. a vector is summed in log steps of shifted adds and the
+// total so far is carried along broadcast in every lane. with only two 8
+// byte lanes this lost to the scalar loop
+template <typename T>
+constexpr bool hasSimdScan() {
+#if defined(__SSE2__)
+  return std::is_integral<T>::value && sizeof(T) == 4;
+#else
+  return false;
+#endif
+}
+
+#if defined(__SSE2__)
+template <typename T>
+__m128i scanStep(__m128i sums) {
+  sums = _mm_add_epi32(sums, _mm_slli_si128(sums, 4));
+  return _mm_add_epi32(sums, _mm_slli_si128(sums, 8));
+}
+
+// out[i] = carry + in[0] + ... + in[i], in and out may be the same
+template <typename T>
+T* inclusiveScanSum(const T* in, const T* last, T* out, T carry) {
+  constexpr ptrdiff_t lanes = 4;
+  __m128i carries = _mm_set1_epi32(static_cast<int>(carry));
+  for (; last - in >= lanes; in += lanes, out += lanes) {
+    __m128i sums = _mm_add_epi32(
+        scanStep<T>(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in))),
+        carries);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), sums);
+    carries = _mm_shuffle_epi32(sums, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  carry = static_cast<T>(_mm_cvtsi128_si32(carries));
+  for (; in != last; ++in, ++out) {
+    carry += *in;
+    *out = carry;
+  }
+  return out;
+}
+
+// out[i] = carry + in[0] + ... + in[i - 1], in and out may be the same
+template <typename T>
+T* exclusiveScanSum(const T* in, const T* last, T* out, T carry) {
+  constexpr ptrdiff_t lanes = 4;
+  __m128i carries = _mm_set1_epi32(static_cast<int>(carry));
+  for (; last - in >= lanes; in += lanes, out += lanes) {
+    __m128i vals = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i sums = _mm_add_epi32(scanStep<T>(vals), carries);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     _mm_sub_epi32(sums, vals));
+    carries = _mm_shuffle_epi32(sums, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  carry = static_cast<T>(_mm_cvtsi128_si32(carries));
+  for (; in != last; ++in, ++out) {
+    T val = *in;
+    *out = carry;
+    carry += val;
+  }
+  return out;
+}
+#endif
+}
@@ -0,0 +1,272 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include "./const_hashmap.h"
+
+namespace cexpr {
+
+// lookup in the manner of gperf for small key sets, the routes of a
+// server say, where hashing the whole key costs more than the lookup. the
+// length of the key picks a group, the keys of that length, and one or
+// two char positions the builder chose for the group tell its keys apart.
+// the two chars are hashed into a slot of the group, by hash and displace
+// as in HashMap but with power of two tables, and a single compare of the
+// key with the one in the slot finishes the lookup:
+//   constexpr cexpr::SwitchMap<routes.size(), cexpr::getMaxKeyLength(routes),
+//                              Handler> map(routes);
+// throws std::logic_error for empty keys, for a maxLength other than
+// getMaxKeyLength, and when no two positions tell the keys of some length
+// apart, as with duplicate keys or keys that only differ in three places.
+// the groups grow with the longest key, the slots with the count as in
+// HashMap
+
+// longest key of arr, see SwitchMap
+template <typename T, size_t size>
+constexpr size_t getMaxKeyLength(const std::array<T, size>& arr) {
+  size_t res = 0;
+  for (size_t i = 0; i < size; i++) {
+    size_t len = length(arr[i].first);
+    res = len > res ? len : res;
+  }
+  return res;
+}
+
+namespace switched {
+// smallest power of two not below size. tables of that size take a mask
+// where HashMap takes a remainder, and the builder's remainder by them is
+// the same mask
+constexpr size_t roundUp(size_t size) {
+  size_t res = 1;
+  while (res < size) {
+    res *= 2;
+  }
+  return res;
+}
+}
+
+template <size_t bufSize, size_t maxLength, typename Value>
+class SwitchMap {
+ public:
+  // lengths that can have keys, every one of them a group at most
+  static constexpr size_t groupCount = bufSize < maxLength ? bufSize
+                                                           : maxLength;
+  // getTableSize and getBucketCount of every group rounded up and laid
+  // end to end, plus slot 0
+  static constexpr size_t slotCount =
+      2 * (bufSize + bufSize / 8 + groupCount) + 1;
+  static constexpr size_t bucketCount = 2 * (bufSize / 2 + groupCount);
+  static_assert(slotCount <= 0xFFFF && maxLength <= 0xFFFF,
+                "a switch map is meant for small key sets");
+
+  // the keys of one length. empty groups keep the defaults and all land
+  // on slot 0, which holds no value
+  struct Group {
+    uint16_t start = 0;
+    uint16_t bucketStart = 0;
+    uint16_t first = 0;
+    uint16_t second = 0;
+    uint32_t seed = 0;
+    // table sizes less one, both powers of two
+    uint32_t bucketMask = 0;
+    uint32_t slotMask = 0;
+  };
+
+  struct Slot {
+    const char* key = nullptr;
+    Value value{};
+  };
+
+  // bytes taken by the groups, the displacements and the slots
+  static constexpr size_t footprint =
+      sizeof(std::array<Group, maxLength + 1>) +
+      sizeof(std::array<uint16_t, bucketCount>) +
+      sizeof(std::array<Slot, slotCount>);
+
+  constexpr SwitchMap(
+      const std::array<std::pair<const char*, Value>, bufSize>& arr)
+      : groups_{}, displacements_{}, slots_{} {
+    std::array<size_t, bufSize> lengths{};
+    for (size_t i = 0; i < bufSize; i++) {
+      lengths[i] = length(arr[i].first);
+      if (lengths[i] == 0) {
+        throw std::logic_error("a switch map cannot hold an empty key");
+      }
+      if (lengths[i] > maxLength) {
+        throw std::logic_error("maxLength is smaller than getMaxKeyLength");
+      }
+    }
+    // slot 0 only has to be readable for as many chars as any lookup
+    // compares, its value stays empty so the compare does not matter
+    for (size_t i = 0; i < bufSize; i++) {
+      if (lengths[i] == maxLength) {
+        getRef(slots_, 0).key = arr[i].first;
+      }
+    }
+    if (slots_[0].key == nullptr) {
+      throw std::logic_error("maxLength is larger than getMaxKeyLength");
+    }
+
+    // sized for a group holding every key, and shared by all
+    Workspace ws{};
+    std::array<size_t, bufSize> members{};
+    size_t nextSlot = 1;
+    size_t nextBucket = 0;
+    for (size_t len = 1; len <= maxLength; len++) {
+      size_t count = 0;
+      for (size_t i = 0; i < bufSize; i++) {
+        if (lengths[i] == len) {
+          members[count++] = i;
+        }
+      }
+      if (count == 0) {
+        continue;
+      }
+      Group& group = getRef(groups_, len);
+      group.start = static_cast<uint16_t>(nextSlot);
+      group.bucketStart = static_cast<uint16_t>(nextBucket);
+      group.bucketMask =
+          static_cast<uint32_t>(switched::roundUp(getBucketCount(count)) - 1);
+      group.slotMask =
+          static_cast<uint32_t>(switched::roundUp(getTableSize(count)) - 1);
+      choosePositions(arr, members, count, len, group);
+      placeGroup(arr, members, count, group, ws);
+      nextSlot += group.slotMask + 1;
+      nextBucket += group.bucketMask + 1;
+    }
+  }
+
+  constexpr Value get(std::string_view key) const {
+    // empty keys wrap around and miss here as well
+    if (key.size() - 1 >= maxLength) {
+      return Value();
+    }
+    const Group& group = groups_[key.size()];
+    const Slot& slot = slots_[slotOf(group, key[group.first],
+                                     key[group.second])];
+    return equalChars(slot.key, key.data(), key.size()) ? slot.value
+                                                        : Value();
+  }
+
+  constexpr Value get(const char* key) const {
+    return get(std::string_view(key, length(key)));
+  }
+
+  constexpr Value get(const char* key, size_t len) const {
+    return get(std::string_view(key, len));
+  }
+
+  constexpr void get_many(const char* const* keys, Value* values,
+                          size_t count) const {
+    for (size_t i = 0; i < count; i++) {
+      values[i] = get(keys[i]);
+    }
+  }
+
+  // the positions the builder chose for keys of len, equal when one
+  // position tells them apart. 0 and 0 for lengths no key has
+  constexpr std::pair<size_t, size_t> positions(size_t len) const {
+    return {groups_[len].first, groups_[len].second};
+  }
+
+ private:
+  using Workspace =
+      DisplacementWorkspace<bufSize,
+                            switched::roundUp(getBucketCount(bufSize)),
+                            switched::roundUp(getTableSize(bufSize))>;
+
+  // the chars the positions picked, mixed into a hash by an odd multiply
+  // and a shift, the high bits folded into the low ones the masks keep.
+  // a bijection for every seed, so keys the positions tell apart never
+  // share a hash
+  static constexpr uint32_t hashOf(uint32_t seed, char first, char second) {
+    uint32_t code = static_cast<uint8_t>(first) |
+                    static_cast<uint32_t>(static_cast<uint8_t>(second)) << 8;
+    uint32_t h = code * ((2 * seed + 1) * 0x9E3779B1u);
+    return h ^ (h >> 15);
+  }
+
+  // the lookup of HashMap, inside the buckets and slots of the group
+  constexpr size_t slotOf(const Group& group, char first,
+                          char second) const {
+    uint32_t hashVal = hashOf(group.seed, first, second);
+    uint16_t displacement =
+        displacements_[group.bucketStart + (hashVal & group.bucketMask)];
+    return group.start + (displace(hashVal, displacement) & group.slotMask);
+  }
+
+  // a single position if one tells the keys apart, the first pair that
+  // does otherwise
+  static constexpr void choosePositions(
+      const std::array<std::pair<const char*, Value>, bufSize>& arr,
+      const std::array<size_t, bufSize>& members, size_t count, size_t len,
+      Group& group) {
+    for (size_t span = 0; span < len; span++) {
+      for (size_t first = 0; first + span < len; first++) {
+        size_t second = first + span;
+        bool distinct = true;
+        for (size_t i = 0; i < count && distinct; i++) {
+          for (size_t j = 0; j < i && distinct; j++) {
+            const char* lhs = arr[members[i]].first;
+            const char* rhs = arr[members[j]].first;
+            distinct = lhs[first] != rhs[first] || lhs[second] != rhs[second];
+          }
+        }
+        if (distinct) {
+          group.first = static_cast<uint16_t>(first);
+          group.second = static_cast<uint16_t>(second);
+          return;
+        }
+      }
+    }
+    throw std::logic_error("no two positions tell the keys of a length apart");
+  }
+
+  // the seed search of HashMap over the hashes of the picked chars, then
+  // the keys go into the slots it found
+  constexpr void placeGroup(
+      const std::array<std::pair<const char*, Value>, bufSize>& arr,
+      const std::array<size_t, bufSize>& members, size_t count, Group& group,
+      Workspace& ws) {
+    size_t buckets = group.bucketMask + 1;
+    size_t slots = group.slotMask + 1;
+    std::array<uint32_t, bufSize> hashes{};
+    std::array<uint16_t, switched::roundUp(getBucketCount(bufSize))>
+        displacements{};
+    bool placed = false;
+    for (uint32_t seed = 0; seed < 256 && !placed; seed++) {
+      for (size_t i = 0; i < count; i++) {
+        const char* key = arr[members[i]].first;
+        hashes[i] = hashOf(seed, key[group.first], key[group.second]);
+      }
+      placed = buildDisplacements(hashes, count, displacements, buckets,
+                                  slots, ws);
+      group.seed = seed;
+    }
+    if (!placed) {
+      throw std::logic_error("no hash seed places the keys of a length");
+    }
+    for (size_t i = 0; i < buckets; i++) {
+      getRef(displacements_, group.bucketStart + i) = displacements[i];
+    }
+    // empty slots point at a key of the group too, so the compare reads
+    // nothing out of bounds, and hold no value
+    for (size_t slot = 0; slot < slots; slot++) {
+      getRef(slots_, group.start + slot).key = arr[members[0]].first;
+    }
+    for (size_t i = 0; i < count; i++) {
+      const char* key = arr[members[i]].first;
+      Slot& slot =
+          getRef(slots_, slotOf(group, key[group.first], key[group.second]));
+      slot.key = key;
+      slot.value = arr[members[i]].second;
+    }
+  }
+
+  std::array<Group, maxLength + 1> groups_;
+  std::array<uint16_t, bucketCount> displacements_;
+  std::array<Slot, slotCount> slots_;
+};
+}
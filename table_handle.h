@@ -0,0 +1,198 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace cexpr {
+
+// epoch based reclamation for TableHandle. a reader announces the epoch
+// it starts in, in a slot only its thread writes, and clears it when it is
+// done. a retired table is freed once every announced epoch is past the
+// one it was retired in, no reader can reach it then. all handles share
+// the one domain, so a thread needs a single slot however many tables it
+// reads
+class EpochDomain {
+ public:
+  // 0 means the thread reads nothing
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<bool> owned{false};
+    // guards of the thread that are alive, only the outermost announces
+    uint32_t depth = 0;
+  };
+
+  // the new epoch, every reader that announces it or a later one started
+  // after the call
+  static uint64_t advance() { return epoch().fetch_add(1) + 1; }
+
+  // smallest epoch a reader announced, or max when none reads
+  static uint64_t oldestActive() {
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    for (const auto& slot : registry().all) {
+      uint64_t epoch = slot->epoch.load();
+      if (epoch != 0 && epoch < oldest) {
+        oldest = epoch;
+      }
+    }
+    return oldest;
+  }
+
+  static void enter() {
+    Slot& slot = local();
+    if (slot.depth++ == 0) {
+      // seq_cst, so the table pointer is loaded after the announcement
+      // is visible to writers
+      slot.epoch.store(epoch().load());
+    }
+  }
+
+  static void leave() {
+    Slot& slot = local();
+    if (--slot.depth == 0) {
+      slot.epoch.store(0, std::memory_order_release);
+    }
+  }
+
+ private:
+  struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Slot>> all;
+  };
+
+  // hands the slot back to the registry when the thread exits
+  struct Owner {
+    Slot* slot;
+    ~Owner() { slot->owned.store(false, std::memory_order_release); }
+  };
+
+  static std::atomic<uint64_t>& epoch() {
+    // starts at 1, 0 is the quiescent marker
+    static std::atomic<uint64_t> value{1};
+    return value;
+  }
+
+  static Registry& registry() {
+    static Registry reg;
+    return reg;
+  }
+
+  static Slot& local() {
+    static thread_local Owner owner{acquire()};
+    return *owner.slot;
+  }
+
+  // a slot a thread left behind, or a new one
+  static Slot* acquire() {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    for (const auto& slot : registry().all) {
+      bool expected = false;
+      if (slot->owned.compare_exchange_strong(expected, true)) {
+        return slot.get();
+      }
+    }
+    registry().all.push_back(std::make_unique<Slot>());
+    registry().all.back()->owned.store(true);
+    return registry().all.back().get();
+  }
+};
+
+// an immutable table that can be swapped for a new one while other
+// threads read it, as on a config reload. readers take no lock and never
+// wait: read() announces the reader and loads the current table, which
+// stays alive until the guard goes away. publish() swaps in a new table
+// and frees the old ones no reader can see any more. Table is any type,
+// a HashMap built at runtime or a MappedHashMap with its blob:
+//   cexpr::TableHandle<Flags> flags(loadFlags());
+//   if (flags.read()->get("dark_mode")) ...
+//   flags.publish(loadFlags());  // on reload, from any thread
+template <typename Table>
+class TableHandle {
+ public:
+  // keeps the table alive, and must not outlive the handle
+  class Guard {
+   public:
+    explicit Guard(const TableHandle& handle) {
+      EpochDomain::enter();
+      table_ = handle.current_.load();
+    }
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+    ~Guard() { EpochDomain::leave(); }
+
+    const Table& operator*() const { return *table_; }
+    const Table* operator->() const { return table_; }
+    const Table* get() const { return table_; }
+
+   private:
+    const Table* table_;
+  };
+
+  explicit TableHandle(std::unique_ptr<const Table> table)
+      : current_(table.release()) {}
+
+  TableHandle(const TableHandle&) = delete;
+  TableHandle& operator=(const TableHandle&) = delete;
+
+  // no reader may be left
+  ~TableHandle() {
+    delete current_.load();
+    for (const auto& retired : retired_) {
+      delete retired.first;
+    }
+  }
+
+  Guard read() const { return Guard(*this); }
+
+  // lookups through a guard of their own, one call per key
+  template <typename Key>
+  auto get(const Key& key) const {
+    return read()->get(key);
+  }
+
+  // swaps in table, returns without waiting for the readers of the old one
+  void publish(std::unique_ptr<const Table> table) {
+    const Table* old = current_.exchange(table.release());
+    // readers announcing this epoch or a later one load the new table
+    uint64_t epoch = EpochDomain::advance();
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired_.emplace_back(old, epoch);
+    reclaimLocked();
+  }
+
+  // frees the retired tables no reader can see any more, and returns how
+  // many are still held by readers. publish calls it too
+  size_t reclaim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reclaimLocked();
+  }
+
+ private:
+  size_t reclaimLocked() {
+    uint64_t oldest = EpochDomain::oldestActive();
+    auto unreachable = std::partition(
+        retired_.begin(), retired_.end(),
+        [oldest](const std::pair<const Table*, uint64_t>& retired) {
+          return retired.second > oldest;
+        });
+    for (auto it = unreachable; it != retired_.end(); ++it) {
+      delete it->first;
+    }
+    retired_.erase(unreachable, retired_.end());
+    return retired_.size();
+  }
+
+  std::atomic<const Table*> current_;
+  std::mutex mutex_;
+  // tables swapped out, with the epoch a reader has to have announced to
+  // no longer see them
+  std::vector<std::pair<const Table*, uint64_t>> retired_;
+};
+}
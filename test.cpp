@@ -1,8 +1,18 @@
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <thread>
+#include <unistd.h>
 #include "./algorithm.h"
 #include "./const_hashmap.h"
+#include "./enum_map.h"
+#include "./execution.h"
+#include "./flat_map.h"
+#include "./mapped_hashmap.h"
+#include "./router.h"
+#include "./sharded_hashmap.h"
+#include "./switch_map.h"
+#include "./table_handle.h"
 
 constexpr bool isOne(const uint32_t& in) { return in != 1; }
 
@@ -35,6 +45,70 @@ struct ConstCharComparator {
   }
 };
 
+// bytes compared unsigned, ConstCharComparator's sign follows char's
+struct ConstCharLess {
+  constexpr bool operator()(const char* lhs, const char* rhs) const {
+    while (*lhs != '\0' && *lhs == *rhs) {
+      lhs++;
+      rhs++;
+    }
+    return static_cast<unsigned char>(*lhs) < static_cast<unsigned char>(*rhs);
+  }
+};
+
+// negative, with a gap, and GET has a second name
+enum class Method : int8_t { kGet = -1, kPut = 0, kPost = 4, kDelete = 5 };
+
+constexpr std::array<std::pair<Method, const char*>, 5> methods{
+    {{Method::kGet, "GET"},
+     {Method::kPut, "PUT"},
+     {Method::kPost, "POST"},
+     {Method::kDelete, "DELETE"},
+     {Method::kGet, "get"}}};
+
+struct Ranked {
+  uint32_t rank;
+  uint32_t order;
+};
+
+constexpr bool rankLess(const Ranked& lhs, const Ranked& rhs) {
+  return lhs.rank < rhs.rank;
+}
+
+constexpr bool testSorts() {
+  // long enough for the quicksort, heapsort and merge passes to kick in
+  std::array<uint32_t, 200> values{};
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = (i * 7919) % 211;
+  }
+  auto sorted = values;
+  cexpr::sort(sorted.begin(), sorted.end());
+  auto descending = values;
+  cexpr::sort(descending.begin(), descending.end(),
+              [](uint32_t lhs, uint32_t rhs) { return lhs > rhs; });
+
+  std::array<Ranked, 200> ranked{};
+  for (size_t i = 0; i < ranked.size(); i++) {
+    ranked[i].rank = values[i] % 5;
+    ranked[i].order = i;
+  }
+  std::array<Ranked, 200> scratch{};
+  cexpr::stable_sort(ranked.begin(), ranked.end(), scratch.begin(), rankLess);
+  for (size_t i = 1; i < ranked.size(); i++) {
+    if (ranked[i - 1].rank == ranked[i].rank &&
+        ranked[i - 1].order > ranked[i].order) {
+      return false;
+    }
+  }
+
+  auto merged = cexpr::mergeSort(values);
+  return cexpr::is_sorted(sorted.cbegin(), sorted.cend()) &&
+         cexpr::equal(sorted.begin(), sorted.end(), merged.begin(),
+                      merged.end()) &&
+         descending[0] == sorted[sorted.size() - 1] &&
+         cexpr::is_sorted(ranked.cbegin(), ranked.cend(), rankLess);
+}
+
 constexpr bool testConstexprFunctions() {
   std::array<size_t, 3>src{1, 2, 3};
   std::array<size_t, 3>dst{};
@@ -46,9 +120,283 @@ constexpr bool testConstexprFunctions() {
   
 }
 
+template <typename Map>
+constexpr bool testGetMany(const Map& map) {
+  const char* keys[] = {"/feed", "hello", "/stories", "/settings", "/login"};
+  std::string (*values[5])() = {};
+  map.get_many(keys, values, 5);
+  for (size_t i = 0; i < 5; i++) {
+    if (values[i] != map.get(keys[i])) {
+      return false;
+    }
+  }
+  return values[1] == nullptr && values[3] == settingHandler;
+}
+
+// runs the runtime kernels over long ranges, with hits past the first
+// vector and in the scalar tail, and compares them to the constexpr path
+template <typename T>
+constexpr bool testSimdAlgorithms() {
+  std::array<T, 100> data{};
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<T>(i % 50);
+  }
+  std::array<T, 100> other = data;
+  other[97] = other[96];
+  auto isSeven = [](const T& v) { return v == 7; };
+  auto isSmall = [](const T& v) { return v < 50; };
+  return cexpr::count(data.cbegin(), data.cend(), T(7)) == 2 &&
+         cexpr::find(data.cbegin(), data.cend(), T(49)) ==
+             data.cbegin() + 49 &&
+         cexpr::find_if(data.cbegin() + 8, data.cend(), isSeven) ==
+             data.cbegin() + 57 &&
+         cexpr::all_of(data.cbegin(), data.cend(), isSmall) &&
+         !cexpr::any_of(data.cbegin() + 58, data.cend(), isSeven) &&
+         cexpr::equal(data.cbegin(), data.cend(), data.cbegin(),
+                      data.cend()) &&
+         !cexpr::equal(data.cbegin(), data.cend(), other.cbegin(),
+                       other.cend()) &&
+         cexpr::adjacent_find(data.cbegin(), data.cend()) == data.cend() &&
+         cexpr::adjacent_find(other.cbegin(), other.cend()) ==
+             other.cbegin() + 96;
+}
+
+// long enough for the lanes and vectors plus a scalar tail, the scans run
+// in place as well
+template <typename T>
+constexpr bool testNumeric() {
+  std::array<T, 203> data{};
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<T>(i % 7 + 1);
+  }
+  std::array<T, 203> scanned{};
+  cexpr::inclusive_scan(data.cbegin(), data.cend(), scanned.begin());
+  std::array<T, 203> shifted = data;
+  cexpr::exclusive_scan(shifted.cbegin(), shifted.cend(), shifted.begin(),
+                        T(5));
+  T sum = 0;
+  for (size_t i = 0; i < data.size(); i++) {
+    if (shifted[i] != static_cast<T>(sum + 5)) {
+      return false;
+    }
+    sum = static_cast<T>(sum + data[i]);
+    if (scanned[i] != sum) {
+      return false;
+    }
+  }
+  auto square = [](const T& v) { return v * v; };
+  return cexpr::accumulate(data.cbegin(), data.cend(), T(1)) ==
+             static_cast<T>(sum + 1) &&
+         cexpr::reduce(data.cbegin(), data.cend()) == sum &&
+         cexpr::reduce(data.cbegin(), data.cend(), T(0),
+                       [](const T& lhs, const T& rhs) {
+                         return lhs > rhs ? lhs : rhs;
+                       }) == 7 &&
+         cexpr::transform_reduce(data.cbegin(), data.cend(), T(0),
+                                 cexpr::Plus<T>(), square) ==
+             cexpr::transform_reduce(data.cbegin(), data.cend(),
+                                     data.cbegin(), T(0));
+}
+
+// the policy overloads split the range across the pool, the results have
+// to match the sequential ones wherever the matches fall
+bool testParallel() {
+  std::vector<uint32_t> data(1 << 20);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<uint32_t>(i % 1000);
+  }
+  auto isLate = [](const uint32_t& v) { return v == 999; };
+  auto isMissing = [](const uint32_t& v) { return v == 1000; };
+  static std::array<uint32_t, 100000> input{};
+  input[70000] = 1;
+  auto incred = cexpr::for_each_array(cexpr::execution::par, input, incr);
+  std::vector<double> halves(1 << 20, 0.5);
+
+  // the global pool may have no workers on this machine, so the pool
+  // itself gets its own threads, nested calls and an exception
+  cexpr::ThreadPool pool(3);
+  std::atomic<size_t> sum{0};
+  pool.parallelFor(64, [&](size_t part) {
+    pool.parallelFor(8, [&](size_t inner) { sum += part * 8 + inner; });
+  });
+  bool thrown = false;
+  try {
+    pool.parallelFor(16, [](size_t part) {
+      if (part == 11) {
+        throw std::runtime_error("part");
+      }
+    });
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  // and a pool without workers runs what it is given on the caller
+  cexpr::ThreadPool empty(0);
+  bool ran = false;
+  empty.submit([&ran] { ran = true; });
+  return sum == 512 * 511 / 2 && thrown && ran &&
+         cexpr::reduce(cexpr::execution::par, data.begin(), data.end()) ==
+             cexpr::reduce(data.begin(), data.end()) &&
+         cexpr::reduce(cexpr::execution::par, halves.data(),
+                       halves.data() + halves.size(), 1.0) ==
+             halves.size() / 2 + 1.0 &&
+         cexpr::count(cexpr::execution::par, data.begin(), data.end(),
+                      7U) == cexpr::count(data.begin(), data.end(), 7U) &&
+         cexpr::count(cexpr::execution::seq, data.begin(), data.end(),
+                      7U) == 1049 &&
+         cexpr::find_if(cexpr::execution::par, data.begin(), data.end(),
+                        isLate) == data.begin() + 999 &&
+         cexpr::find_if(cexpr::execution::par_unseq, data.begin() + 1000,
+                        data.end(), isLate) == data.begin() + 1999 &&
+         cexpr::find_if(cexpr::execution::par, data.begin(), data.end(),
+                        isMissing) == data.end() &&
+         incred[70000] == 2 && incred[69999] == 1 && incred.back() == 1;
+}
+
+// a blob queried in memory and through a mapping of a file, and the
+// header checks of a reader that does not match it
+bool testMapped() {
+  std::vector<std::pair<std::string, uint64_t>> tenants;
+  for (uint64_t i = 0; i < 1000; i++) {
+    tenants.push_back({"tenant-" + std::to_string(i), i + 1});
+  }
+  tenants.push_back({"", 1001});
+  auto blob = cexpr::serializeHashMap<uint64_t>(tenants);
+  if (blob != cexpr::serializeHashMap<uint64_t>(tenants)) {
+    return false;
+  }
+  cexpr::MappedHashMap<uint64_t> map(blob.data(), blob.size());
+  for (const auto& tenant : tenants) {
+    if (map.get(tenant.first) != tenant.second) {
+      return false;
+    }
+  }
+  if (map.size() != 1001 || map.get("tenant-1000") != 0 ||
+      map.get("tenant-1", 7) != 0 || map.get("tenant-12", 8) != 2) {
+    return false;
+  }
+
+  auto rejects = [](auto open) {
+    try {
+      open();
+    } catch (const std::runtime_error&) {
+      return true;
+    }
+    return false;
+  };
+  std::vector<char> damaged = blob;
+  damaged[offsetof(cexpr::MappedHeader, version)]++;
+  bool checked =
+      rejects([&] { cexpr::MappedHashMap<uint32_t>(blob.data(), 64); }) &&
+      rejects([&] {
+        cexpr::MappedHashMap<uint64_t>(blob.data(), blob.size() - 1);
+      }) &&
+      rejects([&] {
+        cexpr::MappedHashMap<uint32_t>(blob.data(), blob.size());
+      }) &&
+      rejects([&] {
+        cexpr::MappedHashMap<uint64_t, cexpr::fnv1Hasher>(blob.data(),
+                                                          blob.size());
+      }) &&
+      rejects([&] {
+        cexpr::MappedHashMap<uint64_t>(damaged.data(), damaged.size());
+      });
+
+  char path[] = "/tmp/cexpr_mapped.XXXXXX";
+  int fd = mkstemp(path);
+  bool written = fd >= 0 && write(fd, blob.data(), blob.size()) ==
+                                static_cast<ssize_t>(blob.size());
+  close(fd);
+  cexpr::MappedFile file(path);
+  unlink(path);
+  cexpr::MappedHashMap<uint64_t> mapped(file.data(), file.size());
+  return checked && written && mapped.get("tenant-42") == 43 &&
+         mapped.get("") == 1001 && mapped.get("tenant") == 0;
+}
+
+// a table that counts its live copies and whose every entry holds its
+// version, so a reader would see a mix of two tables
+struct Versioned {
+  static inline std::atomic<int> live{0};
+  std::array<uint32_t, 64> entries;
+
+  explicit Versioned(uint32_t version) {
+    entries.fill(version);
+    live++;
+  }
+  ~Versioned() { live--; }
+
+  uint32_t get(size_t idx) const { return entries[idx % entries.size()]; }
+};
+
+// swaps under readers, a guard keeps its table alive past a publish and
+// nothing is left once the handle is gone
+bool testTableHandle() {
+  bool ok = true;
+  {
+    cexpr::TableHandle<Versioned> handle(std::make_unique<Versioned>(1));
+    {
+      auto guard = handle.read();
+      auto nested = handle.read();
+      handle.publish(std::make_unique<Versioned>(2));
+      ok = ok && guard->get(3) == 1 && handle.get(3) == 2 &&
+           handle.reclaim() == 1 && Versioned::live == 2;
+    }
+    ok = ok && handle.reclaim() == 0 && Versioned::live == 1;
+
+    std::atomic<bool> stop{false};
+    std::atomic<bool> torn{false};
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < 3; i++) {
+      readers.emplace_back([&handle, &stop, &torn, i] {
+        while (!stop.load()) {
+          auto guard = handle.read();
+          if (guard->get(i) != guard->get(i + 31)) {
+            torn = true;
+          }
+        }
+      });
+    }
+    for (uint32_t version = 3; version < 2000; version++) {
+      handle.publish(std::make_unique<Versioned>(version));
+    }
+    stop = true;
+    for (auto& reader : readers) {
+      reader.join();
+    }
+    ok = ok && !torn && handle.get(0) == 1999 && handle.reclaim() == 0 &&
+         Versioned::live == 1;
+  }
+  return ok && Versioned::live == 0;
+}
+
 int main() {
   static_assert(cexpr::fnv1a("hello") == 0x4f9f2cab, "did not pass for fnv1a");
   static_assert(cexpr::fnv1("hello") == 0xe31c0e3f, "did not pass for fnv1");
+  static_assert(cexpr::fnv1("/ab") == cexpr::fnv1("/ba"), "fnv1 is unordered");
+  static_assert(cexpr::fnv1("/ab", 1) != cexpr::fnv1("/ba", 1), "unless seeded");
+  static_assert(cexpr::fnv1a("hello", 0) == cexpr::fnv1a("hello"), "seed 0");
+  static_assert(cexpr::fnv1a("\xe9") == 0x6c0b6c44, "bytes are unsigned");
+  static_assert(cexpr::fnv1(std::string_view("\xe9")) == 0x681df30e,
+                "bytes are unsigned");
+  static_assert(cexpr::wordHash("") != cexpr::wordHash("a"), "length matters");
+  static_assert(cexpr::wordHash("hello world, hi") ==
+                    cexpr::wordHash("hello world, hi!", 15),
+                "explicit length");
+  static_assert(cexpr::wordHash("/notification", 13, 1) !=
+                    cexpr::wordHash("/notification", 13, 2),
+                "seeded");
+  {
+    // runtime word loads must match the constexpr byte loads, including
+    // from unaligned addresses
+    constexpr uint64_t expected = cexpr::wordHash("/notification/settings");
+    std::string unaligned = "x/notification/settings";
+    assert(cexpr::wordHash(unaligned.c_str() + 1) == expected);
+    assert(cexpr::wordHash(unaligned.c_str() + 1, unaligned.size() - 1) ==
+           expected);
+    constexpr uint32_t expected32 = cexpr::wordHasher()("/notification");
+    assert(cexpr::wordHasher()(std::string_view(unaligned.c_str() + 1, 13)) ==
+           expected32);
+  }
 
   constexpr std::array<uint32_t, 3> lhs{1, 3, 5};
   constexpr std::array<uint32_t, 3> rhs{2, 4, 6};
@@ -94,6 +442,50 @@ int main() {
   }) == (conseq.begin() + 1), "1 is on the front, so matches next");
   constexpr auto res = testConstexprFunctions();
   static_assert(res, "trivially true");
+  static_assert(testSorts(), "sort and stable_sort");
+  static_assert(cexpr::lower_bound(conseq.begin(), conseq.end(), 4U) ==
+                    conseq.begin() + 3,
+                "first 4");
+  static_assert(cexpr::upper_bound(conseq.begin(), conseq.end(), 4U) ==
+                    conseq.begin() + 5,
+                "after the last 4");
+  static_assert(cexpr::equal_range(conseq.begin(), conseq.end(), 5U).second ==
+                    conseq.end(),
+                "5 is last");
+  static_assert(cexpr::binary_search(conseq.begin(), conseq.end(), 3U), "3");
+  static_assert(!cexpr::binary_search(conseq.begin(), conseq.end(), 6U), "6");
+  static_assert(testSimdAlgorithms<uint8_t>(), "bytes");
+  static_assert(testSimdAlgorithms<uint64_t>(), "words");
+  assert(testSimdAlgorithms<uint8_t>());
+  assert(testSimdAlgorithms<uint16_t>());
+  assert(testSimdAlgorithms<uint32_t>());
+  assert(testSimdAlgorithms<uint64_t>());
+  // other element types keep the early exit, the predicate stops at the
+  // hit
+  std::array<const char*, 64> words{};
+  words.fill("miss");
+  words[40] = "hit";
+  size_t calls = 0;
+  auto isHit = [&calls](const char* word) {
+    calls++;
+    return std::strcmp(word, "hit") == 0;
+  };
+  assert(cexpr::find_if(words.data(), words.data() + words.size(), isHit) ==
+         words.data() + 40);
+  assert(calls == 41);
+  assert(testParallel());
+  assert(testMapped());
+  assert(testTableHandle());
+  static_assert(testNumeric<uint32_t>(), "numeric");
+  assert(testNumeric<uint8_t>());
+  assert(testNumeric<uint32_t>());
+  assert(testNumeric<int64_t>());
+  assert(testNumeric<double>());
+  constexpr std::array<uint32_t, 4> lengths{3, 0, 5, 2};
+  constexpr auto offsets = cexpr::exclusive_scan_array(lengths, size_t(0));
+  static_assert(offsets[2] == 3 && offsets[3] == 8, "offset table");
+  static_assert(cexpr::inclusive_scan_array(lengths).back() == 10, "total");
+  static_assert(cexpr::reduce_array(lengths) == 10, "total");
 
   // end test algorithm file
 
@@ -118,6 +510,402 @@ int main() {
   static_assert(map.get("hello") == nullptr, "no pointer");
   static_assert(map.get("/login") == emptyHandler, "empty handler");
   static_assert(map.get("/settings") == settingHandler, "setting!");
+  static_assert(mapSize < 2 * urls.size(), "table stays close to N slots");
+  static_assert(map.get("/stories") == emptyHandler, "last key");
+  static_assert(map.get("/storie") == nullptr, "prefix is a miss");
+
+  // slices of a buffer, neither NUL terminated nor copied
+  constexpr std::string_view request = "GET /settings/x /feed";
+  static_assert(map.get(request.substr(4, 9)) == settingHandler, "slice");
+  static_assert(map.get(request.substr(4, 8)) == nullptr, "short slice");
+  static_assert(map.get(request.substr(4, 11)) == nullptr, "long slice");
+  static_assert(map.get(request.substr(16)) == emptyHandler, "tail slice");
+  static_assert(cexpr::fnv1(std::string_view("/feed")) == cexpr::fnv1("/feed"),
+                "same hash");
+  static_assert(cexpr::fnv1a(std::string_view("/feed"), 3) ==
+                    cexpr::fnv1a("/feed", 3),
+                "same hash");
+  const char packet[] = {'/', 'n', 'o', 't', 'e', 's', '/'};
+  assert(map.get(packet, 6) == emptyHandler);
+  assert(map.get(packet, 7) == nullptr);
+
+  constexpr cexpr::MinimalHashMap<10, const char*, std::string (*)(),
+                                  ConstCharComparator, cexpr::fnv1Hasher>
+      minimalMap(urls);
+  static_assert(minimalMap.get("/login") == emptyHandler, "empty handler");
+  static_assert(minimalMap.get("/settings") == settingHandler, "setting!");
+  static_assert(minimalMap.get("hello") == nullptr, "no pointer");
+  static_assert(minimalMap.footprint < map.footprint, "one slot per key");
+  static_assert(minimalMap.footprint <= sizeof(minimalMap), "all accounted");
+
+  constexpr cexpr::HashMap<10, mapSize, const char*, std::string (*)(),
+                           ConstCharComparator, cexpr::fnv1Hasher, true>
+      taggedMap(urls);
+  static_assert(taggedMap.get("/login") == emptyHandler, "empty handler");
+  static_assert(taggedMap.get("/settings") == settingHandler, "setting!");
+  static_assert(taggedMap.get("hello") == nullptr, "no pointer");
+  static_assert(taggedMap.get("/storie") == nullptr, "prefix is a miss");
+  static_assert(taggedMap.get(request.substr(4, 9)) == settingHandler,
+                "slice");
+
+  constexpr cexpr::HashMap<10, mapSize, const char*, std::string (*)(),
+                           ConstCharComparator, cexpr::fnv1Hasher, true,
+                           cexpr::NoInstrumentation, cexpr::SoaLayout>
+      soaMap(urls);
+  static_assert(soaMap.get("/login") == emptyHandler, "empty handler");
+  static_assert(soaMap.get("/settings") == settingHandler, "setting!");
+  static_assert(soaMap.get("hello") == nullptr, "no pointer");
+  static_assert(soaMap.get(request.substr(4, 9)) == settingHandler, "slice");
+  static_assert(soaMap.seed() == taggedMap.seed(), "same table");
+  static_assert(soaMap.stats().max_key_length == 13, "/notification");
+  static_assert(testGetMany(soaMap), "batch matches get");
+  assert(soaMap.get("/feed") == emptyHandler);
+  assert(soaMap.get(packet, 7) == nullptr);
+
+  constexpr auto poolSize = cexpr::getKeyPoolSize(urls);
+  constexpr cexpr::PooledHashMap<10, mapSize, poolSize, std::string (*)(),
+                                 cexpr::fnv1aHasher>
+      pooledMap(urls);
+  static_assert(poolSize == 79, "sum of the key lengths");
+  static_assert(pooledMap.get("/login") == emptyHandler, "empty handler");
+  static_assert(pooledMap.get("/settings") == settingHandler, "setting!");
+  static_assert(pooledMap.get("/stories") == emptyHandler, "last key");
+  static_assert(pooledMap.get("hello") == nullptr, "no pointer");
+  static_assert(pooledMap.get("/storie") == nullptr, "prefix is a miss");
+  static_assert(pooledMap.get("") == nullptr, "empty key");
+  static_assert(pooledMap.get(request.substr(4, 9)) == settingHandler,
+                "slice");
+  static_assert(pooledMap.footprint <= sizeof(pooledMap), "all accounted");
+  assert(pooledMap.get("/settings") == settingHandler);
+  assert(pooledMap.get(packet, 6) == emptyHandler);
+  assert(pooledMap.get(packet, 7) == nullptr);
+  static_assert(taggedMap.footprint == map.footprint + 4 * mapSize, "tags");
+  static_assert(testGetMany(map), "batch matches get");
+  static_assert(testGetMany(taggedMap), "batch matches get");
+#if defined(__cpp_lib_span)
+  {
+    // a longer output span keeps the entries past the keys
+    const char* spanKeys[] = {"/feed", "hello"};
+    std::string (*spanValues[3])() = {};
+    map.get_many(std::span<const char* const>(spanKeys),
+                 std::span<std::string (*)()>(spanValues));
+    assert(spanValues[0] == map.get("/feed") && spanValues[1] == nullptr);
+    assert(spanValues[2] == nullptr);
+  }
+#endif
+  constexpr cexpr::HashMapStats stats = map.stats();
+  static_assert(stats.keys == 10 && stats.slots == mapSize, "sizes");
+  static_assert(stats.load_factor > 0.8, "load factor budget");
+  static_assert(stats.bytes == map.footprint, "bytes");
+  static_assert(stats.seed_attempts == map.seed() + 1, "seeds");
+  static_assert(std::string_view(stats.hash) == "fnv1", "hash");
+  static_assert(stats.max_comparisons == 1, "one comparison");
+  static_assert(stats.max_key_length == 13, "/notification");
+  static_assert(minimalMap.stats().load_factor == 1.0, "minimal");
+
+  // the same table as generate_hashmap writes it out, keys in slot order
+  constexpr cexpr::HashMap<10, mapSize, const char*, std::string (*)(),
+                           ConstCharComparator, cexpr::fnv1Hasher>
+      prebuiltMap(0u, {{2, 0, 13, 0, 0, 5}},
+                  {{"/stories", "/notification", "/videos", nullptr, "/login",
+                    "/feed", nullptr, "/messenger", "/profile", "/logout",
+                    "/notes", "/settings"}},
+                  {{emptyHandler, emptyHandler, emptyHandler, nullptr,
+                    emptyHandler, emptyHandler, nullptr, emptyHandler,
+                    emptyHandler, emptyHandler, emptyHandler,
+                    settingHandler}});
+  static_assert(prebuiltMap.seed() == map.seed(), "same seed");
+  static_assert(prebuiltMap.stats().max_displacement ==
+                    stats.max_displacement,
+                "same displacements");
+  static_assert(prebuiltMap.get("/settings") == settingHandler, "setting!");
+  static_assert(prebuiltMap.get("/stories") == emptyHandler, "slot 0");
+  static_assert(prebuiltMap.get("hello") == nullptr, "no pointer");
+  static_assert(cexpr::CStringComparator()("/feed", "/feed") == 0, "equal");
+  static_assert(cexpr::CStringComparator()("/feed", nullptr) != 0, "empty");
+  static_assert(cexpr::CStringComparator()("/fee", "/feed") < 0, "prefix");
+  // and the runtime builder the generator runs finds the same table
+  std::vector<const char*> urlKeys;
+  for (const auto& url : urls) {
+    urlKeys.push_back(url.first);
+  }
+  uint32_t runtimeSeed = 1;
+  std::vector<uint16_t> runtimeDisplacements =
+      cexpr::getDisplacements<cexpr::fnv1Hasher>(urlKeys, mapSize,
+                                                 runtimeSeed);
+  assert(runtimeSeed == map.seed());
+  assert((runtimeDisplacements == std::vector<uint16_t>{2, 0, 13, 0, 0, 5}));
+  // as does the constexpr one given the keys without their values
+  static_assert(
+      [&] {
+        std::array<const char*, 10> keysOnly{};
+        for (size_t i = 0; i < urls.size(); i++) {
+          keysOnly[i] = urls[i].first;
+        }
+        uint32_t keysSeed = 0;
+        auto keysDisplacements =
+            cexpr::getDisplacements<cexpr::fnv1Hasher, mapSize>(keysOnly,
+                                                                keysSeed);
+        uint32_t pairsSeed = 1;
+        auto pairsDisplacements =
+            cexpr::getDisplacements<cexpr::fnv1Hasher, mapSize>(urls,
+                                                                pairsSeed);
+        for (size_t i = 0; i < keysDisplacements.size(); i++) {
+          if (keysDisplacements[i] != pairsDisplacements[i]) {
+            return false;
+          }
+        }
+        return keysSeed == pairsSeed;
+      }(),
+      "keys alone");
+
+  // the sharded lookups divide by runtime table sizes without dividing
+  static_assert(cexpr::FastMod(7)(0xFFFFFFFFu) == 0xFFFFFFFFu % 7, "mod");
+  static_assert(cexpr::FastMod(1)(12345) == 0, "by one");
+  static_assert(cexpr::FastMod(1000003)(0x9E3779B1u) == 0x9E3779B1u % 1000003,
+                "large divisor");
+
+  // seed searches split over two constant expressions, then merged
+  constexpr auto lowShards =
+      cexpr::getShardTables<cexpr::fnv1Hasher, 3>(urls, 0, 1);
+  constexpr auto highShards =
+      cexpr::getShardTables<cexpr::fnv1Hasher, 3>(urls, 1, 3);
+  constexpr cexpr::ShardedHashMap<10, 3, const char*, std::string (*)(),
+                                  ConstCharComparator, cexpr::fnv1Hasher>
+      shardedMap(urls, cexpr::mergeShardTables(lowShards, highShards));
+  constexpr cexpr::ShardedHashMap<10, 3, const char*, std::string (*)(),
+                                  ConstCharComparator, cexpr::fnv1Hasher>
+      wholeShardedMap(urls);
+  static_assert(lowShards.built[0] && !lowShards.built[1], "first shard");
+  static_assert(shardedMap.get("/login") == emptyHandler, "empty handler");
+  static_assert(shardedMap.get("/settings") == settingHandler, "setting!");
+  static_assert(shardedMap.get("/stories") == emptyHandler, "last key");
+  static_assert(shardedMap.get("hello") == nullptr, "no pointer");
+  static_assert(shardedMap.get("/storie") == nullptr, "prefix is a miss");
+  static_assert(shardedMap.reseeded() == wholeShardedMap.reseeded(),
+                "same seeds");
+  static_assert(wholeShardedMap.get("/notes") == emptyHandler, "unsplit");
+  for (const auto& url : urls) {
+    assert(shardedMap.get(url.first) == url.second);
+  }
+
+  // by length, then by one or two chars
+  constexpr cexpr::SwitchMap<10, cexpr::getMaxKeyLength(urls),
+                             std::string (*)()>
+      switchMap(urls);
+  static_assert(cexpr::getMaxKeyLength(urls) == 13, "/notification");
+  static_assert(switchMap.get("/login") == emptyHandler, "empty handler");
+  static_assert(switchMap.get("/settings") == settingHandler, "setting!");
+  static_assert(switchMap.get("/stories") == emptyHandler, "last key");
+  static_assert(switchMap.get("hello") == nullptr, "no pointer");
+  static_assert(switchMap.get("/storie") == nullptr, "prefix is a miss");
+  static_assert(switchMap.get("/stories/") == nullptr, "longer is a miss");
+  static_assert(switchMap.get("") == nullptr, "empty key");
+  static_assert(switchMap.get("/notification/x") == nullptr, "too long");
+  static_assert(switchMap.get("/setlings") == nullptr, "same chars picked");
+  static_assert(switchMap.get(request.substr(4, 9)) == settingHandler,
+                "slice");
+  // /login and /notes differ right after the slash
+  static_assert(switchMap.positions(6) == std::pair<size_t, size_t>(1, 1),
+                "one position");
+  static_assert(switchMap.positions(2) == std::pair<size_t, size_t>(0, 0),
+                "no keys");
+  static_assert(testGetMany(switchMap), "batch matches get");
+  constexpr std::array<std::pair<const char*, uint32_t>, 4> pairKeys{
+      {{"ab", 1}, {"ba", 2}, {"aa", 3}, {"abc", 4}}};
+  constexpr cexpr::SwitchMap<4, 3, uint32_t> pairMap(pairKeys);
+  static_assert(pairMap.positions(2) == std::pair<size_t, size_t>(0, 1),
+                "no single position tells ab, ba and aa apart");
+  static_assert(pairMap.get("aa") == 3 && pairMap.get("ba") == 2, "pair");
+  static_assert(pairMap.get("bb") == 0 && pairMap.get("abd") == 0, "miss");
+  // 40 keys of one length, too many for a single char position
+  constexpr std::array<std::pair<const char*, uint32_t>, 40> sameLength{
+      {{"/apsfija", 1}, {"/bgcgofd", 2}, {"/boyvzrm", 3}, {"/brejner", 4},
+       {"/cnnchcr", 5}, {"/dlsbqgb", 6}, {"/dpbgyje", 7}, {"/dsjrvfd", 8},
+       {"/ecfehvh", 9}, {"/enrltsk", 10}, {"/ewqtuvx", 11}, {"/gqlewra", 12},
+       {"/iwnlvmh", 13}, {"/kemubcr", 14}, {"/ktbdase", 15}, {"/kxojtcd", 16},
+       {"/lpddpop", 17}, {"/mmmdpum", 18}, {"/nbsdhuu", 19}, {"/nbvcyrs", 20},
+       {"/oljhzfw", 21}, {"/omrienr", 22}, {"/pjcedxk", 23}, {"/qlflyhr", 24},
+       {"/qnfykep", 25}, {"/rdltacg", 26}, {"/sbssmbh", 27}, {"/ssugldr", 28},
+       {"/szoccip", 29}, {"/tmeuilt", 30}, {"/usvojwm", 31}, {"/vlaolft", 32},
+       {"/vrnykos", 33}, {"/wcsbtgp", 34}, {"/wvcbxwj", 35}, {"/xhmmpcf", 36},
+       {"/xipwfqa", 37}, {"/yhcsjqp", 38}, {"/yqjucwi", 39}, {"/zkkwltp", 40}}};
+  constexpr cexpr::SwitchMap<40, 8, uint32_t> sameLengthMap(sameLength);
+  static_assert(
+      [&] {
+        for (const auto& entry : sameLength) {
+          if (sameLengthMap.get(entry.first) != entry.second) {
+            return false;
+          }
+        }
+        return true;
+      }(),
+      "every key");
+  static_assert(sameLengthMap.positions(8).first !=
+                    sameLengthMap.positions(8).second,
+                "two positions");
+  static_assert(sameLengthMap.get("/zzzzzzz") == 0, "miss");
+  static_assert(sameLengthMap.footprint < 4096, "linear in the keys");
+  for (const auto& url : urls) {
+    assert(switchMap.get(url.first) == url.second);
+  }
+  assert(switchMap.get(packet, 6) == emptyHandler);
+  assert(switchMap.get(packet, 7) == nullptr);
+  // slot 0 needs a key of maxLength chars, misses of any length land there
+  constexpr std::array<std::pair<const char*, int>, 2> shortKeys{
+      {{"ab", 1}, {"cd", 2}}};
+  bool tooLong = false;
+  try {
+    cexpr::SwitchMap<2, 4, int> loose(shortKeys);
+    (void)loose;
+  } catch (const std::logic_error&) {
+    tooLong = true;
+  }
+  assert(tooLong);
+  constexpr cexpr::SwitchMap<2, 2, int> shortMap(shortKeys);
+  static_assert(shortMap.get("cd") == 2, "exact maxLength");
+  assert(shortMap.get("xyz") == 0 && shortMap.get("q") == 0);
+  assert(shortMap.get("xy") == 0 && shortMap.get("") == 0);
+
+  constexpr cexpr::EnumMap<Method, 5, cexpr::getEnumSpan(methods)>
+      methodNames(methods);
+  static_assert(cexpr::getEnumSpan(methods) == 7, "-1 to 5");
+  static_assert(methodNames.name(Method::kPost) == "POST", "name");
+  static_assert(methodNames.name(Method::kGet) == "GET", "first name");
+  static_assert(methodNames.name(static_cast<Method>(1)).empty(), "gap");
+  static_assert(methodNames.name(static_cast<Method>(-2)).empty(), "below");
+  static_assert(methodNames.name(static_cast<Method>(6)).empty(), "above");
+  static_assert(methodNames.parse("DELETE") == Method::kDelete, "parse");
+  static_assert(methodNames.parse("get") == Method::kGet, "second name");
+  static_assert(!methodNames.parse("DELET"), "prefix is a miss");
+  static_assert(!methodNames.parse(""), "empty name");
+  static_assert(methodNames.parse("PATCH", Method::kPut) == Method::kPut,
+                "fallback");
+  static_assert(methodNames.parse(request.substr(0, 3)) == Method::kGet,
+                "slice");
+  assert(methodNames.parse("POST") == Method::kPost);
+  assert(!methodNames.parse("post"));
+  assert(methodNames.name(Method::kDelete) == "DELETE");
+
+  // counters only move at runtime, every lookup is sampled here
+  using Counted = cexpr::Instrumented<struct CountedUrls, 1>;
+  constexpr cexpr::HashMap<10, mapSize, const char*, std::string (*)(),
+                           ConstCharComparator, cexpr::fnv1Hasher, true,
+                           Counted>
+      countedMap(urls);
+  static_assert(countedMap.get("/settings") == settingHandler, "setting!");
+  static_assert(countedMap.get("hello") == nullptr, "no pointer");
+  assert(countedMap.get("/settings") == settingHandler);
+  std::thread([&countedMap] {
+    assert(countedMap.get("/login") == emptyHandler);
+    assert(countedMap.get("/storie") == nullptr);
+  }).join();
+  const char* batch[] = {"/feed", "/feeds"};
+  std::string (*found[2])();
+  countedMap.get_many(batch, found, 2);
+  cexpr::LookupSnapshot snap = Counted::snapshot();
+  assert(snap.gets == 5 && snap.hits == 3 && snap.misses == 2);
+  assert(snap.compares >= 3 && snap.compares <= 5);
+  assert(snap.samples == 3);
+  assert(cexpr::accumulate(snap.cycles.begin(), snap.cycles.end(),
+                           uint64_t(0)) == snap.samples);
+  // short lived threads reuse the blocks of exited ones, counts included
+  for (int i = 0; i < 20; i++) {
+    std::thread([&countedMap] {
+      assert(countedMap.get("/feed") != nullptr);
+    }).join();
+  }
+  assert(Counted::blocks() == 2);
+  assert(Counted::snapshot().gets == 25 && Counted::snapshot().hits == 23);
+  static_assert(sizeof(map) - map.footprint < alignof(std::pair<void*, void*>),
+                "untagged map only has padding beyond its footprint");
+
+  // every key collides with another one under the unseeded fnv1
+  constexpr std::array<std::pair<const char*, int>, 4> reordered{
+      {{"/ab", 1}, {"/ba", 2}, {"/abc", 3}, {"/cba", 4}}};
+  constexpr cexpr::HashMap<4, cexpr::getPerfectHashSize<cexpr::fnv1Hasher>(
+                                  reordered),
+                           const char*, int, ConstCharComparator,
+                           cexpr::fnv1Hasher>
+      seededMap(reordered);
+  static_assert(seededMap.seed() != 0, "seed 0 cannot separate the keys");
+  static_assert(seededMap.get("/ab") == 1, "first key");
+  static_assert(seededMap.get("/ba") == 2, "reordered key");
+  static_assert(seededMap.get("/cba") == 4, "reordered key");
+  static_assert(seededMap.get("/bca") == 0, "missing key");
+
+  constexpr auto wordMapSize =
+      cexpr::getPerfectHashSize<cexpr::wordHasher>(urls);
+  constexpr cexpr::HashMap<10, wordMapSize, const char*, std::string (*)(),
+                           ConstCharComparator, cexpr::wordHasher>
+      wordMap(urls);
+  static_assert(wordMap.get("/notification") == emptyHandler, "empty handler");
+  static_assert(wordMap.get("/settings") == settingHandler, "setting!");
+  static_assert(wordMap.get("hello") == nullptr, "no pointer");
+  assert(wordMap.get("/settings") == settingHandler);
+  assert(wordMap.get(std::string_view("/settingsX", 9)) == settingHandler);
+
+  constexpr cexpr::FlatMap<10, const char*, std::string (*)(), ConstCharLess>
+      flatMap(urls);
+  static_assert(flatMap.get("/settings") == settingHandler, "setting!");
+  static_assert(flatMap.get("/login") == emptyHandler, "empty handler");
+  static_assert(flatMap.get("hello") == nullptr, "no pointer");
+  static_assert(flatMap.get("/zzz") == nullptr, "past the last key");
+  static_assert(flatMap.lower_bound("/") == 0, "before the first key");
+  static_assert(flatMap.lower_bound("/zzz") == flatMap.size(), "none left");
+  // "/notes" and "/notification" sort between "/n" and "/o"
+  static_assert(flatMap.lower_bound("/n") + 2 == flatMap.lower_bound("/o"),
+                "range query");
+  static_assert(ConstCharComparator()(
+                    flatMap.key(flatMap.lower_bound("/n")), "/notes") == 0,
+                "first in range");
+  static_assert(flatMap.equal_range("/feed").second -
+                        flatMap.equal_range("/feed").first ==
+                    1,
+                "one match");
+  static_assert(flatMap.find("/messenger") + 1 == flatMap.find("/notes"),
+                "neighbours");
+
+  constexpr std::array<std::pair<const char*, int>, 7> routes{
+      {{"/", 1},
+       {"/feed", 2},
+       {"/profile", 3},
+       {"/profile/{id}", 4},
+       {"/profile/{id}/photos/{photo}", 5},
+       {"/profile/settings", 6},
+       {"/static/*", 7}}};
+  constexpr cexpr::Router<7, cexpr::getRouterNodeCount(routes),
+                          cexpr::getRouterParamCount(routes), int>
+      router(routes);
+  static_assert(router.get("/") == 1, "root");
+  static_assert(router.get("/feed") == 2, "literal");
+  static_assert(router.get("/fee") == 0, "prefix of a literal");
+  static_assert(router.get("/feeds") == 0, "longer than a literal");
+  static_assert(router.get("/profile") == 3, "literal");
+  static_assert(router.get("/profile/42") == 4, "parameter");
+  static_assert(router.get("/profile/settings") == 6, "literal wins");
+  static_assert(router.get("/profile/settingsX") == 4, "literal prefix");
+  static_assert(router.get("/profile/set") == 4, "prefix of a literal");
+  static_assert(router.get("/profile/settings/photos/7") == 5,
+                "literal dead end");
+  static_assert(router.get("/profile/") == 0, "empty parameter");
+  static_assert(router.get("/static/") == 7, "empty wildcard");
+  static_assert(router.get("/static/css/site.css") == 7, "wildcard");
+  static_assert(router.get("/stat") == 0, "no wildcard yet");
+  constexpr std::string_view photoPath = "/profile/42/photos/7";
+  constexpr auto photo = router.match(photoPath);
+  static_assert(photo && photo.handler == 5, "two parameters");
+  static_assert(photo.paramCount == 2, "two parameters");
+  static_assert(photo.param(photoPath, 0) == "42", "first parameter");
+  static_assert(photo.param(photoPath, 1) == "7", "second parameter");
+  static_assert(!router.match("/profile/42/photos"), "missing parameter");
+  constexpr std::string_view deadEndPath = "/profile/settings/photos/7";
+  static_assert(router.match(deadEndPath).param(deadEndPath, 0) ==
+                    "settings",
+                "parameter after backtracking");
+  static_assert(router.match(deadEndPath).paramCount == 2, "no leftovers");
+  static_assert(router.match("/static/a.js").wildcardOffset == 8, "rest");
+
   std::cout << (void*)(map.get("/login")) << std::endl;
   std::cout << (void*)(map.get("/settings")) << std::endl;
 
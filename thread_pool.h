@@ -0,0 +1,198 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cexpr {
+
+// small work stealing pool for the runtime parallel algorithms. every
+// worker owns a deque, takes its own work from the back and steals from
+// the front of the others when it runs dry. the thread waiting on a
+// parallelFor works through the queues too, so nested calls from inside a
+// task cannot deadlock the pool
+class ThreadPool {
+ public:
+  using Task = std::function<void()>;
+
+  explicit ThreadPool(size_t workers) : queues_(workers) {
+    threads_.reserve(workers);
+    for (size_t i = 0; i < workers; i++) {
+      threads_.emplace_back([this, i] { work(i); });
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  // one worker per core, the caller of parallelFor being the last one
+  static ThreadPool& global() {
+    static ThreadPool pool(
+        std::max<size_t>(std::thread::hardware_concurrency(), 1) - 1);
+    return pool;
+  }
+
+  size_t size() const { return threads_.size(); }
+
+  // a pool without workers, the global one on a single core, runs the
+  // task right away on the caller
+  void submit(Task task) {
+    if (queues_.empty()) {
+      task();
+      return;
+    }
+    size_t idx = currentPool_ == this
+                     ? currentWorker_
+                     : next_.fetch_add(1, std::memory_order_relaxed) %
+                           queues_.size();
+    // counted before it is queued, so a worker that takes it at once
+    // never brings pending_ below zero
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex_);
+      pending_++;
+    }
+    {
+      std::lock_guard<std::mutex> lock(queues_[idx].mutex);
+      queues_[idx].tasks.push_back(std::move(task));
+    }
+    wake_.notify_one();
+  }
+
+  // calls fn(part) for every part in [0, parts) and returns once all of
+  // them finished. the first exception thrown by a part is rethrown here
+  template <typename Fn>
+  void parallelFor(size_t parts, const Fn& fn) {
+    if (parts == 0) {
+      return;
+    }
+    if (queues_.empty() || parts == 1) {
+      for (size_t part = 0; part < parts; part++) {
+        fn(part);
+      }
+      return;
+    }
+
+    std::atomic<size_t> left{parts};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    std::mutex doneMutex;
+    std::condition_variable done;
+    auto runPart = [&](size_t part) {
+      try {
+        fn(part);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+      // under the lock, so the caller cannot return and take done with
+      // it between the count reaching zero and the notify
+      std::lock_guard<std::mutex> lock(doneMutex);
+      if (left.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        done.notify_one();
+      }
+    };
+    for (size_t part = 1; part < parts; part++) {
+      submit([&runPart, part] { runPart(part); });
+    }
+    runPart(0);
+
+    // helps with queued work while there is some, then sleeps until the
+    // parts still running elsewhere finish
+    size_t home = currentPool_ == this ? currentWorker_ : 0;
+    while (left.load(std::memory_order_acquire) != 0) {
+      if (runOne(home)) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(doneMutex);
+      done.wait(lock, [&left] {
+        return left.load(std::memory_order_acquire) == 0;
+      });
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // runs one task, from the back of the home queue or stolen from the
+  // front of another one. false when every queue is empty
+  bool runOne(size_t home) {
+    for (size_t i = 0; i < queues_.size(); i++) {
+      Queue& queue = queues_[(home + i) % queues_.size()];
+      Task task;
+      {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+          continue;
+        }
+        if (i == 0) {
+          task = std::move(queue.tasks.back());
+          queue.tasks.pop_back();
+        } else {
+          task = std::move(queue.tasks.front());
+          queue.tasks.pop_front();
+        }
+      }
+      {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        pending_--;
+      }
+      task();
+      return true;
+    }
+    return false;
+  }
+
+  void work(size_t idx) {
+    currentPool_ = this;
+    currentWorker_ = idx;
+    while (true) {
+      if (runOne(idx)) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleepMutex_);
+      wake_.wait(lock, [this] { return stop_ || pending_ != 0; });
+      if (stop_ && pending_ == 0) {
+        return;
+      }
+    }
+  }
+
+  static inline thread_local ThreadPool* currentPool_ = nullptr;
+  static inline thread_local size_t currentWorker_ = 0;
+
+  std::vector<Queue> queues_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> next_{0};
+  // tasks queued but not started yet, guarded by sleepMutex_
+  size_t pending_ = 0;
+  bool stop_ = false;
+  std::mutex sleepMutex_;
+  std::condition_variable wake_;
+};
+}